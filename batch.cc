@@ -0,0 +1,169 @@
+/*
+   Batch adjudication of recorded games
+
+   Usage:
+     trax -b [-j threads] [-a] path...
+
+     Replays each record through the referee on a pool of threads and
+     prints one line per game, in the order of the paths:
+       file  winner  result  move  notation  time(ms)
+     result is loop, line, violation, none (game not over) or error
+     (record cannot be read), and move is the number of the move that
+     ended the game. A directory path adjudicates its *.trx files, and
+     "-" reads paths from stdin, one per line. -a checks the whole board
+     for consistency after every move instead of the cells it changed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "trax.h"
+#include "timer.hpp"
+#include "trx_record.hpp"
+
+struct batch_result {
+  int winner;
+  const char* result;
+  int move_number;
+  char notation[move::MAX_LENGTH];
+  double time_ms;
+};
+
+static bool full_audit = false;
+
+
+static void collect_paths(const std::string& path,
+                          std::vector<std::string>& paths){
+  struct stat st;
+  if(stat(path.c_str(), &st)!=0 || !S_ISDIR(st.st_mode)){
+    paths.push_back(path);
+    return;
+  }
+  DIR* dir = opendir(path.c_str());
+  if(!dir) return;
+  std::vector<std::string> names;
+  while(struct dirent* entry = readdir(dir)){
+    std::string name = entry->d_name;
+    if(name.length() > 4 && name.compare(name.length()-4, 4, ".trx")==0)
+      names.push_back(path + "/" + name);
+  }
+  closedir(dir);
+  std::sort(names.begin(), names.end());
+  paths.insert(paths.end(), names.begin(), names.end());
+}
+
+// Same judgement as a game played by main(), player 1 moves first
+static void adjudicate(const std::vector<move>& moves, batch_result& r){
+  trax* t = new trax();
+  t->clear_board();
+
+  for(size_t i=0; i<moves.size(); i++){
+    const move& mo = moves[i];
+    int p = (i%2==0) ? 1 : 2;
+    r.move_number = i+1;
+    mo.format(r.notation, sizeof(r.notation));
+
+    // a move this far out would run off the referee's board arrays
+    bool fits = t->fits(mo);
+    bool violation = !fits || !t->place(mo);
+    if(fits && (full_audit ? t->is_board_consistent_full() :
+                t->is_board_consistent())){
+      if(t->loop() || t->line()){
+        r.winner = t->winner(p);
+        r.result = t->loop() ? "loop" : "line";
+        delete t;
+        return;
+      }
+    } else {
+      violation = true;
+    }
+    if(violation){
+      r.winner = (p==1) ? 2 : 1;
+      r.result = "violation";
+      delete t;
+      return;
+    }
+    t->clear_marks();
+  }
+  r.move_number = 0;
+  r.notation[0] = '\0';
+  delete t;
+}
+
+static void batch_worker(const std::vector<std::string>& paths,
+                         std::vector<batch_result>& results,
+                         std::atomic<int>& next){
+  for(int i=next++; i<(int)paths.size(); i=next++){
+    batch_result& r = results[i];
+    double start = GetMonotonicTimeMs();
+    std::vector<move> moves;
+    std::string metadata;
+    r.winner = 0;
+    r.result = "none";
+    r.move_number = 0;
+    r.notation[0] = '\0';
+    if(TrxRecord::Read(paths[i].c_str(), moves, metadata))
+      adjudicate(moves, r);
+    else
+      r.result = "error";
+    r.time_ms = GetMonotonicTimeMs() - start;
+  }
+}
+
+int batch_main(int argc, char* argv[]){
+  int num_threads = std::thread::hardware_concurrency();
+  std::vector<std::string> paths;
+
+  for(int i=0; i<argc; i++){
+    if(strcmp(argv[i], "-j")==0 && i+1<argc){
+      num_threads = atoi(argv[++i]);
+    } else if(strcmp(argv[i], "-a")==0){
+      full_audit = true;
+    } else if(strcmp(argv[i], "-")==0){
+      std::string line;
+      while(std::getline(std::cin, line))
+        if(!line.empty()) collect_paths(line, paths);
+    } else {
+      collect_paths(argv[i], paths);
+    }
+  }
+  if(num_threads < 1) num_threads = 1;
+  if(paths.empty()){
+    std::cerr << "usage: trax -b [-j threads] [-a] path...\n";
+    return 1;
+  }
+
+  double start = GetMonotonicTimeMs();
+  std::vector<batch_result> results(paths.size());
+  std::atomic<int> next(0);
+  std::vector<std::thread> threads;
+  for(int i=0; i<num_threads; i++)
+    threads.push_back(std::thread(batch_worker, std::cref(paths),
+                                  std::ref(results), std::ref(next)));
+  for(size_t i=0; i<threads.size(); i++) threads[i].join();
+  double elapsed = GetMonotonicTimeMs() - start;
+
+  int num_violations = 0, num_errors = 0;
+  for(size_t i=0; i<paths.size(); i++){
+    const batch_result& r = results[i];
+    printf("%s\t%d\t%s\t%d\t%s\t%.3f\n", paths[i].c_str(), r.winner,
+           r.result, r.move_number, r.notation[0] ? r.notation : "-",
+           r.time_ms);
+    if(strcmp(r.result, "violation")==0) num_violations++;
+    if(strcmp(r.result, "error")==0) num_errors++;
+  }
+  fprintf(stderr, "%d games, %d violations, %d errors, %d threads, "
+          "%.1f ms, %.0f games/s\n", (int)paths.size(), num_violations,
+          num_errors, num_threads, elapsed,
+          elapsed > 0 ? paths.size()*1000.0/elapsed : 0.0);
+  return num_errors ? 1 : 0;
+}
@@ -3,16 +3,24 @@
 
 
 #include <stdio.h>
+#include <stdint.h>
 #include <string.h>
+#include <vector>
 
 #include "trax.h"
+#include "move_list.hpp"
+#include "rules.hpp"
 #include "timer.hpp"
 
 
 /**
  * blocks_ is row-major array
+ * paths_ holds both ends of every open path at the edge slots they end on
+ * The rules of a cell come from Rules, indexed by GetAroundIndex
  */
-class Board {
+class Board : public Rules<Board> {
+
+  friend class Rules<Board>;
 
  protected:
 
@@ -30,37 +38,17 @@ class Board {
     FIELD_TILE   = 0xf,  // 4bit [3:0]
     FIELD_PLACED = 0x10, // 1bit [4:4]
   };
-  
-  enum ColorPattern {
-    COL_CLEAR = 0,
-    COL_WHITE = 1,
-    COL_RED   = 2,
-  };
-
-  /**
-   * N: North, E: East, S: South, W: West
-   */
-  enum DirectionPattern {
-    DIR_N = 0,
-    DIR_E = 1,
-    DIR_S = 2,
-    DIR_W = 3,
-  };
 
   /**
-   * The bit-order is (W,S,E,N), N is LSB.
-   * If the bit is one, the direction's color is red.
+   * Bitset layout, cell (x, y) is bit (x % WORD_BITS) of word
+   * [y][x / WORD_BITS]
    */
-  enum TilePattern {
-    TILE_SPACE  = 0x0,  // ' ' (0000)
-    TILE_RED_NS = 0x5,  // '+' (0101)
-    TILE_RED_EW = 0xa,  // '+' (1010)
-    TILE_RED_WN = 0x9,  // '/' (1001)
-    TILE_RED_ES = 0x6,  // '/' (0110)
-    TILE_RED_SW = 0xc,  // '\' (1100)
-    TILE_RED_NE = 0x3,  // '\' (0011)
+  typedef uint64_t Word;
+  enum BitboardLayout {
+    WORD_BITS = 64,
+    ROW_WORDS = (BOARD_MAX + WORD_BITS - 1) / WORD_BITS,
   };
-
+  
   /**
    * Sum of tile-patterns constructed loop candidate
    *
@@ -87,6 +75,47 @@ class Board {
     LOOP_RED_3_W = LOOP_RED_2_W + TILE_RED_NS,
   };
 
+  /**
+   * Weights of GetPathBalance
+   */
+  enum PathWeight {
+    SPAN_WEIGHT = 2,   // per tile of the longer side of a path's extent
+    LOOP_WEIGHT = 64,  // divided by distance between the two ends + 1
+  };
+
+  /**
+   * Open end of a path, stored at the edge slot where the path ends.
+   * Slot 2 * cell is N edge of the cell, and 2 * cell + 1 is W edge.
+   */
+  struct PathEnd {
+    short other;  // slot of the other end, -1 if the slot is not an end
+    char color;
+    unsigned char min_x, max_x, min_y, max_y;  // extent of the path's tiles
+  };
+
+  struct PathUndo {
+    int slot;
+    PathEnd end;
+  };
+
+  /**
+   * Change of the frontier, cell removed from index or added (index -1)
+   */
+  struct FrontierUndo {
+    short cell;
+    short index;
+  };
+
+  /**
+   * Zobrist keys, the key of tile t at (x, y) is tile[t] * px[x] * py[y] so
+   * that a translation of the whole board is one multiplication
+   */
+  struct ZobristTable {
+    uint64_t tile[FIELD_TILE + 1];
+    uint64_t px[BOARD_MAX], py[BOARD_MAX];
+    uint64_t px_inv[BOARD_MAX], py_inv[BOARD_MAX];
+  };
+
 
   //----------------------------------------------------------------------------
   // Members
@@ -96,11 +125,35 @@ class Board {
   char blocks_[BOARD_MAX][BOARD_MAX];
   int border_n_, border_e_, border_s_, border_w_;
 
+  // Frontier (empty and non-isolated cells), cell is y * BOARD_MAX + x
+  short frontier_[BOARD_MAX * BOARD_MAX];
+  short frontier_index_[BOARD_MAX * BOARD_MAX];  // -1 if not in frontier
+  int num_frontier_;
+  char valid_shapes_[BOARD_MAX * BOARD_MAX];     // legal-shape mask
+  std::vector<FrontierUndo> frontier_journal_;   // changes of frontier_
+
+  // Forced play propagation
+  short worklist_[BOARD_MAX * BOARD_MAX];        // ring buffer of cells
+  Word queued_[BOARD_MAX][ROW_WORDS];            // cells in worklist_
+
+  // Undo journal, cells in placed order
+  short journal_[BOARD_MAX * BOARD_MAX];
+  int journal_size_;
+  int last_move_;                                // journal index of last move
+
+  // Sum of Zobrist keys of placed tiles
+  uint64_t hash_;
+
+  // Path registry
+  PathEnd paths_[BOARD_MAX * BOARD_MAX * 2];
+  std::vector<PathUndo> path_journal_;
+  int win_flags_;                                // WinFlag of last move
+
   // Timers
-  Timer *set_move_time_;
-  Timer *is_valid_move_time_;
-  Timer *get_around_colors_time_;
-  Timer *detect_loop_time_;
+  ProfileTimer set_move_time_;
+  ProfileTimer is_valid_move_time_;
+  ProfileTimer get_around_colors_time_;
+  ProfileTimer detect_loop_time_;
 
 
   //----------------------------------------------------------------------------
@@ -141,11 +194,10 @@ class Board {
   inline char GetTileField(int x, int y) { return GetTileField(blocks_[y][x]); }
    
   /**
-   * Get opposite color of argument color
+   * Bit of cell x in its word of a bitset row
    */
-  static inline int GetOppositeColor(const int color) {
-    return (color == COL_WHITE) ? COL_RED :
-        (color == COL_RED) ? COL_WHITE : COL_CLEAR;
+  static inline Word GetCellBit(const int x) {
+    return (Word)1 << (x % WORD_BITS);
   }
 
   /**
@@ -154,119 +206,50 @@ class Board {
   inline void GetAroundColors(const int x, const int y,
                               int &col_n, int &col_e,
                               int &col_s, int &col_w) {
-    get_around_colors_time_->Start();
+    get_around_colors_time_.Start();
     col_n = GetColorS(x, y - 1);
     col_e = GetColorW(x + 1, y);
     col_s = GetColorN(x, y + 1);
     col_w = GetColorE(x - 1, y);
-    get_around_colors_time_->Stop();
-  }
-
-  /**
-   * Get (x, y)'s color
-   */
-  inline int GetColor(const char shape,
-                      const int col_n, const int col_e,
-                      const int col_s, const int col_w) {
-    if (shape == '+') {
-      return (col_w == COL_WHITE || col_e == COL_WHITE ||
-              col_n == COL_RED || col_s == COL_RED) ? COL_WHITE : COL_RED;
-    } else if (shape == '/') {
-      return (col_w == COL_WHITE || col_n == COL_WHITE ||
-              col_s == COL_RED || col_e == COL_RED) ? COL_RED : COL_WHITE;
-    } else if (shape == '\\') {
-      return (col_w == COL_WHITE || col_s == COL_WHITE ||
-              col_n == COL_RED || col_e == COL_RED) ? COL_RED : COL_WHITE;
-    }
-    return COL_CLEAR;
+    get_around_colors_time_.Stop();
   }
 
   /**
-   * Get (x, y)'s color
+   * Get packed around colors of (x, y), an index of the rule table
    */
-  inline int GetColor(const int x, const int y, const char shape) {
+  inline int GetAroundIndex(const int x, const int y) {
     int col_n, col_e, col_s, col_w;
     GetAroundColors(x, y, col_n, col_e, col_s, col_w);
-    return GetColor(shape, col_n, col_e, col_s, col_w);
+    return col_n + 3 * col_e + 9 * col_s + 27 * col_w;
   }
 
-  /**
-   * Check whether (x, y) is consistent placement
-   */
-  inline bool IsConsistentPlacement(int x, int y, char shape) {
-    int col_n, col_e, col_s, col_w;
-    GetAroundColors(x, y, col_n, col_e, col_s, col_w);
-    if (shape == '+') {
-      if ((col_w != col_e && (col_w != COL_CLEAR && col_e != COL_CLEAR)) ||
-          (col_n != col_s && (col_n != COL_CLEAR && col_s != COL_CLEAR))) {
-        return false;
-      }
-    }
-    if (shape == '/') {
-      if ((col_w != col_n && (col_w != COL_CLEAR && col_n != COL_CLEAR)) ||
-          (col_s != col_e && (col_s != COL_CLEAR && col_e != COL_CLEAR))) {
-        return false;
-      }
-    }
-    if (shape == '\\') {
-      if ((col_w != col_s && (col_w != COL_CLEAR && col_s != COL_CLEAR)) ||
-          (col_n != col_e && (col_n != COL_CLEAR && col_e != COL_CLEAR))) {
-        return false;
-      }
-    }
-    return true;
-  }
+  
+ public:
 
-  /**
-   * Check whether (x, y) is line color connected
-   */
-  inline bool IsLineColorConnected(const int x, const int y, const char shape) {
-    int col_n, col_e, col_s, col_w;
-    int my_col_n, my_col_e, my_col_s, my_col_w;
-    GetAroundColors(x, y, col_n, col_e, col_s, col_w);
-    my_col_e = GetColor(x, y, shape);
-    my_col_w = (shape == '+')  ? my_col_e : GetOppositeColor(my_col_e);
-    my_col_n = (shape == '\\') ? my_col_e : GetOppositeColor(my_col_e);
-    my_col_s = (shape == '/')  ? my_col_e : GetOppositeColor(my_col_e);
-    if ((my_col_e != col_e && (col_e != COL_CLEAR)) ||
-        (my_col_w != col_w && (col_w != COL_CLEAR)) ||
-        (my_col_n != col_n && (col_n != COL_CLEAR)) ||
-        (my_col_s != col_s && (col_s != COL_CLEAR))) {
-      return false;
-    }
-    return true;
-  }
+  //----------------------------------------------------------------------------
+  // Typedefs and Constants
+  //----------------------------------------------------------------------------
+
+  enum WinFlag {
+    WIN_WHITE_LOOP = 0x1,
+    WIN_RED_LOOP   = 0x2,
+    WIN_WHITE_LINE = 0x4,
+    WIN_RED_LINE   = 0x8,
+  };
 
   /**
-   * Check whether (x, y) is prohibit pattern
+   * State to take back a move, returned by MakeMove
    */
-  inline bool IsProhibited3(const int x, const int y) {
-    int col_n, col_e, col_s, col_w;
-    GetAroundColors(x, y, col_n, col_e, col_s, col_w);
-    if ((col_w == col_e && col_e == col_n && col_n != COL_CLEAR) ||
-        (col_e == col_n && col_n == col_s && col_s != COL_CLEAR) ||
-        (col_n == col_s && col_s == col_w && col_w != COL_CLEAR) ||
-        (col_s == col_w && col_w == col_e && col_e != COL_CLEAR)) {
-      return true;
-    }
-    return false;
-  }
-
-  void CreateTimer() {
-    set_move_time_ = new Timer("SetMove");
-    is_valid_move_time_ = new Timer("IsValidMove");
-    get_around_colors_time_ = new Timer("GetAroundColors");
-    detect_loop_time_ = new Timer("Detect{White,Red}Loop");
-  }
-
-  void DestroyTimer() {
-    delete set_move_time_;
-    delete is_valid_move_time_;
-    delete get_around_colors_time_;
-  }
+  struct UndoToken {
+    int journal_size;
+    int path_journal_size;
+    int frontier_journal_size;
+    int last_move;
+    int border_n, border_e, border_s, border_w;
+    int win_flags;
+    bool is_valid;  // false if forced plays of the move break the rules
+  };
 
-  
- public:
 
   //----------------------------------------------------------------------------
   // Members
@@ -288,29 +271,76 @@ class Board {
       border_n_(BOARD_CENTER),
       border_e_(BOARD_CENTER),
       border_s_(BOARD_CENTER),
-      border_w_(BOARD_CENTER) {
-    memset(blocks_, 0, sizeof(char) * BOARD_MAX * BOARD_MAX);
-    CreateTimer();
+      border_w_(BOARD_CENTER),
+      set_move_time_("SetMove"),
+      is_valid_move_time_("IsValidMove"),
+      get_around_colors_time_("GetAroundColors"),
+      detect_loop_time_("Detect{White,Red}Loop") {
+    path_journal_.reserve(BOARD_MAX * BOARD_MAX);
+    frontier_journal_.reserve(BOARD_MAX * BOARD_MAX);
+    Clear();
+  }
+
+  /**
+   * Copy constructor, left, right, top and bottom refer to the copy
+   */
+  Board(const Board &board) :
+      set_move_time_("SetMove"),
+      is_valid_move_time_("IsValidMove"),
+      get_around_colors_time_("GetAroundColors"),
+      detect_loop_time_("Detect{White,Red}Loop") {
+    path_journal_.reserve(BOARD_MAX * BOARD_MAX);
+    frontier_journal_.reserve(BOARD_MAX * BOARD_MAX);
+    *this = board;
   }
 
   /**
-   * Destructor
+   * Copy tiles and every cache of board, but not the timers
    */
-  ~Board() {
-    DestroyTimer();
+  Board &operator=(const Board &board) {
+    if (this == &board) return *this;
+    memcpy(blocks_, board.blocks_, sizeof(blocks_));
+    border_n_ = board.border_n_;
+    border_e_ = board.border_e_;
+    border_s_ = board.border_s_;
+    border_w_ = board.border_w_;
+    memcpy(frontier_, board.frontier_, sizeof(frontier_));
+    memcpy(frontier_index_, board.frontier_index_, sizeof(frontier_index_));
+    num_frontier_ = board.num_frontier_;
+    memcpy(valid_shapes_, board.valid_shapes_, sizeof(valid_shapes_));
+    frontier_journal_ = board.frontier_journal_;
+    memset(queued_, 0, sizeof(queued_));
+    memcpy(journal_, board.journal_, sizeof(journal_));
+    journal_size_ = board.journal_size_;
+    last_move_ = board.last_move_;
+    hash_ = board.hash_;
+    memcpy(paths_, board.paths_, sizeof(paths_));
+    path_journal_ = board.path_journal_;
+    win_flags_ = board.win_flags_;
+    return *this;
+  }
+
+  /**
+   * Remove all tiles
+   */
+  void Clear() {
+    memset(blocks_, 0, sizeof(char) * BOARD_MAX * BOARD_MAX);
+    memset(frontier_index_, 0xff, sizeof(frontier_index_));
+    memset(valid_shapes_, 0, sizeof(valid_shapes_));
+    num_frontier_ = 0;
+    frontier_journal_.clear();
+    memset(queued_, 0, sizeof(queued_));
+    journal_size_ = 0;
+    last_move_ = 0;
+    hash_ = 0;
+    memset(paths_, 0xff, sizeof(paths_));
+    path_journal_.clear();
+    win_flags_ = 0;
+    border_n_ = border_e_ = border_s_ = border_w_ = BOARD_CENTER;
   }
 
   static inline char GetTileShape(char block) {
-    switch (block & FIELD_TILE) {
-      case TILE_RED_NS: return '+'; break;
-      case TILE_RED_EW: return '+'; break;
-      case TILE_RED_WN: return '/'; break;
-      case TILE_RED_ES: return '/'; break;
-      case TILE_RED_SW: return '\\'; break;
-      case TILE_RED_NE: return '\\'; break;
-      default: return ' ';
-    }
-    return ' ';
+    return GetTileEntry(block).shape;
   }
 
   inline char GetTileShape(int x, int y) {  
@@ -321,16 +351,7 @@ class Board {
    * Return east color of tile
    */
   static inline int GetTileColor(char block) {
-    switch (block & FIELD_TILE) {
-      case TILE_RED_NS: return COL_WHITE; break;
-      case TILE_RED_EW: return COL_RED; break;
-      case TILE_RED_WN: return COL_WHITE; break;
-      case TILE_RED_ES: return COL_RED; break;
-      case TILE_RED_SW: return COL_WHITE; break;
-      case TILE_RED_NE: return COL_RED; break;
-      default: return COL_CLEAR;
-    }
-    return COL_CLEAR;
+    return GetTileEntry(block).color;
   }
 
   inline char GetTileColor(int x, int y) {  
@@ -338,22 +359,8 @@ class Board {
   }
 
   inline char GetTileFormat(int x, int y, char shape) {
-    int color = GetTileColor(x, y);
-    char ret_tile = TILE_SPACE;
-    if (color == COL_WHITE) {
-      switch (shape) {
-        case '+':  ret_tile = TILE_RED_NS; break;
-        case '/':  ret_tile = TILE_RED_WN; break;
-        case '\\': ret_tile = TILE_RED_SW; break;
-      }
-    } else {
-      switch (shape) {
-        case '+':  ret_tile = TILE_RED_EW; break;
-        case '/':  ret_tile = TILE_RED_ES; break;
-        case '\\': ret_tile = TILE_RED_NE; break;
-      }
-    }
-    return ret_tile;
+    if (shape != '+' && shape != '/' && shape != '\\') return TILE_SPACE;
+    return GetShapeTile(GetShapeIndex(shape), GetTileColor(x, y));
   }
 
   inline char GetTileFormat(const move m) {
@@ -361,25 +368,11 @@ class Board {
   }
 
   static inline char FlipTileHorizontal(const char tile) {
-    char flipped = tile;
-    switch (tile) {
-      case TILE_RED_ES: flipped = TILE_RED_SW; break;
-      case TILE_RED_SW: flipped = TILE_RED_ES; break;
-      case TILE_RED_WN: flipped = TILE_RED_NE; break;
-      case TILE_RED_NE: flipped = TILE_RED_WN; break;
-    }
-    return flipped;
+    return GetTileEntry(tile).flipped_h;
   }
 
   static inline char FlipTileVertical(const char tile) {
-    char flipped = tile;
-    switch (tile) {
-      case TILE_RED_ES: flipped = TILE_RED_NE; break;
-      case TILE_RED_NE: flipped = TILE_RED_ES; break;
-      case TILE_RED_WN: flipped = TILE_RED_SW; break;
-      case TILE_RED_SW: flipped = TILE_RED_WN; break;
-    }
-    return flipped;
+    return GetTileEntry(tile).flipped_v;
   }
   
   /**
@@ -405,113 +398,421 @@ class Board {
    * Check to set a move on board
    */
   bool IsValidMove(const int x, const int y, const char shape) {
-    is_valid_move_time_->Start();
-    bool is_valid = true;
-    do {
+    is_valid_move_time_.Start();
 #if 0  // USE_SAFETY_CHECK
-      if (IsPlaced(x, y)) {
-        is_valid = false;
-        break;
-      }
-      if (IsIsolated(x, y)) {
-        is_valid = false;
-        break;
-      }
+    if (IsPlaced(x, y) || IsIsolated(x, y)) {
+      is_valid_move_time_.Stop();
+      return false;
+    }
 #endif  // end USE_SAFETY_CHECK
-      if (!IsLineColorConnected(x, y, shape)) {
-        is_valid = false;
-        break;
-      }
-      if (IsProhibited3(x, y)) {
-        is_valid = false;
-        break;
-      }
-      if (!IsConsistentPlacement(x, y, shape)) {
-        is_valid = false;
-        break;
-      }
-    } while (0);    
-    is_valid_move_time_->Stop();
+    bool is_valid = (GetValidShapes(x, y) >> GetShapeIndex(shape)) & 0x1;
+    is_valid_move_time_.Stop();
     return is_valid;
   }
 
+  /**
+   * Check the cell of a move is one cell inside the board, so that its
+   * neighbors can be read. Check it before anything else of a move from
+   * outside, such as a record.
+   */
+  inline bool IsInside(const move m) {
+    const int x = m.x + border_w_, y = m.y + border_n_;
+    return m.x >= 0 && m.y >= 0 && x >= 1 && x <= BOARD_MAX - 2 &&
+        y >= 1 && y <= BOARD_MAX - 2;
+  }
+
   /**
    * Check to set a move on board
    */
   bool IsValidMove(const move m) {
-    is_valid_move_time_->Start();
     return IsValidMove(m.x + border_w_, m.y + border_n_, m.tile);
-    is_valid_move_time_->Stop();
   }
 
   /**
-   * Seach and set forced moves
+   * Get number of frontier cells
    */
-  bool ScanForced() {
-    for(int y = border_n_; y <= border_s_; y++) {
-      for(int x = border_w_; x <= border_e_; x++) {
-        if(IsPlaced(blocks_[y][x])) continue;
-        int col_n, col_e, col_s, col_w;
-        GetAroundColors(x, y, col_n, col_e, col_s, col_w);
-        char forced = ' ';
-        if ((col_w == col_n && col_n != COL_CLEAR) ||
-            (col_s == col_e && col_e != COL_CLEAR)) {
-          forced = '/';
-        }
-        if ((col_e == col_n && col_n != COL_CLEAR) ||
-            (col_s == col_w && col_w != COL_CLEAR)) {
-          forced = '\\';
-        }
-        if ((col_w == col_e && col_e != COL_CLEAR &&
-             col_e != col_s && col_e != col_n) ||
-            (col_n == col_s && col_s != COL_CLEAR &&
-             col_s != col_w && col_s != col_w)) {
-          forced = '+';
-        }
-        if (forced != ' ') {
-          SetMove(x, y, forced);
-          return true; 
+  inline int GetNumFrontier() {
+    return num_frontier_;
+  }
+
+  /**
+   * Get i-th frontier cell and its legal-shape mask (bit s is ShapeIndex s)
+   * The order of cells changes with every move and comes back with
+   * UnmakeMove, so gather the cells before making moves.
+   */
+  inline void GetFrontier(const int i, int &x, int &y, int &valid_shapes) {
+    int cell = frontier_[i];
+    x = cell % BOARD_MAX;
+    y = cell / BOARD_MAX;
+    valid_shapes = valid_shapes_[cell];
+  }
+
+  /**
+   * Pick up every move allowed by the legal-shape masks
+   */
+  void GatherMoves(MoveList &moves) {
+    moves.Clear();
+    for (int i = 0; i < num_frontier_; i++) {
+      int cell = frontier_[i];
+      for (int s = SHAPE_PLUS; s < SHAPE_NUM; s++) {
+        if ((valid_shapes_[cell] >> s) & 0x1) {
+          moves.Push(MoveList::Pack(cell, s));
         }
       }
     }
-    // No more forced play here
+  }
+
+  static inline MoveList::Move PackMove(const int x, const int y,
+                                        const int shape_id) {
+    return MoveList::Pack(y * BOARD_MAX + x, shape_id);
+  }
+
+  static inline void UnpackMove(const MoveList::Move m, int &x, int &y) {
+    x = MoveList::GetCell(m) % BOARD_MAX;
+    y = MoveList::GetCell(m) / BOARD_MAX;
+  }
+
+  /**
+   * Convert a packed move to the notation, relative to the bounding box
+   */
+  move ToMove(const MoveList::Move m) {
+    move result;
+    UnpackMove(m, result.x, result.y);
+    result.x -= border_w_;
+    result.y -= border_n_;
+    result.tile = MoveList::GetShape(m);
+    return result;
+  }
+
+  /**
+   * Add (x, y) to frontier or remove it, and refresh its legal-shape mask
+   */
+  inline void UpdateFrontier(const int x, const int y) {
+    if (x <= 0 || y <= 0 || x >= BOARD_MAX - 1 || y >= BOARD_MAX - 1) return;
+    int cell = y * BOARD_MAX + x;
+    int index = frontier_index_[cell];
+    if (IsPlaced(x, y) || IsIsolated(x, y)) {
+      if (index < 0) return;
+      FrontierUndo undo = {(short)cell, (short)index};
+      frontier_journal_.push_back(undo);
+      // swap with the last one
+      int last = frontier_[--num_frontier_];
+      frontier_[index] = last;
+      frontier_index_[last] = index;
+      frontier_index_[cell] = -1;
+      valid_shapes_[cell] = 0;
+      return;
+    }
+    if (index < 0) {
+      FrontierUndo undo = {(short)cell, -1};
+      frontier_journal_.push_back(undo);
+      frontier_index_[cell] = num_frontier_;
+      frontier_[num_frontier_++] = cell;
+    }
+    valid_shapes_[cell] = GetValidShapes(x, y);
+  }
+
+  /**
+   * Take back one change of the frontier, changes are undone in reverse
+   */
+  inline void UndoFrontier(const FrontierUndo &undo) {
+    if (undo.index < 0) {
+      // added at the end
+      frontier_index_[undo.cell] = -1;
+      num_frontier_--;
+      return;
+    }
+    // removed by swapping the last one into its place
+    if (undo.index < num_frontier_) {
+      int moved = frontier_[undo.index];
+      frontier_[num_frontier_] = moved;
+      frontier_index_[moved] = num_frontier_;
+    }
+    frontier_[undo.index] = undo.cell;
+    frontier_index_[undo.cell] = undo.index;
+    num_frontier_++;
+  }
+
+  /**
+   * Refresh the legal-shape mask of (x, y) after the frontier is restored
+   */
+  inline void RefreshValidShapes(const int x, const int y) {
+    if (x <= 0 || y <= 0 || x >= BOARD_MAX - 1 || y >= BOARD_MAX - 1) return;
+    int cell = y * BOARD_MAX + x;
+    valid_shapes_[cell] =
+        (frontier_index_[cell] < 0) ? 0 : GetValidShapes(x, y);
+  }
+
+  /**
+   * splitmix64, used for Zobrist keys and to finalize hashes
+   */
+  static inline uint64_t MixHash(uint64_t h) {
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    return h ^ (h >> 31);
+  }
+
+  /**
+   * Inverse of odd a modulo 2^64
+   */
+  static inline uint64_t GetInverse(const uint64_t a) {
+    uint64_t inv = a;
+    for (int i = 0; i < 5; i++) {
+      inv *= 2 - a * inv;
+    }
+    return inv;
+  }
+
+  static ZobristTable CreateZobristTable() {
+    ZobristTable table;
+    uint64_t seed = 0;
+    table.tile[TILE_SPACE] = 0;
+    for (int t = 1; t <= FIELD_TILE; t++) {
+      table.tile[t] = MixHash(seed += 0x9e3779b97f4a7c15ULL);
+    }
+    uint64_t ax = MixHash(seed += 0x9e3779b97f4a7c15ULL) | 0x1;
+    uint64_t ay = MixHash(seed += 0x9e3779b97f4a7c15ULL) | 0x1;
+    uint64_t ax_inv = GetInverse(ax), ay_inv = GetInverse(ay);
+    table.px[0] = table.py[0] = table.px_inv[0] = table.py_inv[0] = 1;
+    for (int i = 1; i < BOARD_MAX; i++) {
+      table.px[i] = table.px[i - 1] * ax;
+      table.py[i] = table.py[i - 1] * ay;
+      table.px_inv[i] = table.px_inv[i - 1] * ax_inv;
+      table.py_inv[i] = table.py_inv[i - 1] * ay_inv;
+    }
+    return table;
+  }
+
+  static const ZobristTable &GetZobristTable() {
+    static const ZobristTable table = CreateZobristTable();
+    return table;
+  }
+
+  static inline uint64_t GetZobristKey(const ZobristTable &table,
+                                       const int x, const int y,
+                                       const int tile_field) {
+    return table.tile[tile_field] * table.px[x] * table.py[y];
+  }
+
+  /**
+   * Swap bit i and bit j of tile field
+   */
+  static inline int SwapTileBits(const int field, const int i, const int j) {
+    int diff = ((field >> i) ^ (field >> j)) & 0x1;
+    return field ^ ((diff << i) | (diff << j));
+  }
+
+  /**
+   * Map a tile at (x, y) in a width x height box by one of 8 symmetries.
+   * Bit 2 of sym transposes, bit 0 mirrors x and bit 1 mirrors y.
+   */
+  static inline void TransformTile(const int sym,
+                                   const int width, const int height,
+                                   int &x, int &y, int &field) {
+    int w = width, h = height;
+    if (sym & 0x4) {
+      int tmp = x; x = y; y = tmp;
+      w = height;
+      h = width;
+      field = SwapTileBits(SwapTileBits(field, DIR_N, DIR_W), DIR_E, DIR_S);
+    }
+    if (sym & 0x1) {
+      x = w - 1 - x;
+      field = SwapTileBits(field, DIR_E, DIR_W);
+    }
+    if (sym & 0x2) {
+      y = h - 1 - y;
+      field = SwapTileBits(field, DIR_N, DIR_S);
+    }
+  }
+
+  /**
+   * Write a block and mirror it into the hash
+   */
+  inline void WriteBlock(const int x, const int y, const char block) {
+    const ZobristTable &table = GetZobristTable();
+    hash_ -= GetZobristKey(table, x, y, GetTileField(blocks_[y][x]));
+    hash_ += GetZobristKey(table, x, y, GetTileField(block));
+    blocks_[y][x] = block;
+  }
+
+  /**
+   * Write a block and mirror it into the frontier and hash
+   */
+  inline void SetBlock(const int x, const int y, const char block) {
+    WriteBlock(x, y, block);
+    UpdateFrontier(x, y);
+    UpdateFrontier(x, y - 1);
+    UpdateFrontier(x + 1, y);
+    UpdateFrontier(x, y + 1);
+    UpdateFrontier(x - 1, y);
+  }
+
+  /**
+   * Get edge slot of (x, y) at direction d
+   */
+  static inline int GetSlot(const int x, const int y, const int d) {
+    return (d == DIR_N) ? (y * BOARD_MAX + x) * 2 :
+        (d == DIR_W) ? (y * BOARD_MAX + x) * 2 + 1 :
+        (d == DIR_S) ? ((y + 1) * BOARD_MAX + x) * 2 :
+        (y * BOARD_MAX + x + 1) * 2 + 1;
+  }
+
+  /**
+   * Write a path end with undo record
+   */
+  inline void SetPathEnd(const int slot, const PathEnd &end) {
+    PathUndo undo;
+    undo.slot = slot;
+    undo.end = paths_[slot];
+    path_journal_.push_back(undo);
+    paths_[slot] = end;
+  }
+
+  /**
+   * Check whether a path with ends at slot0 and slot1 connects the
+   * opposite borders
+   */
+  inline bool IsLine(const int slot0, const int slot1, const PathEnd &path) {
+    int x0 = (slot0 / 2) % BOARD_MAX, y0 = (slot0 / 2) / BOARD_MAX;
+    int x1 = (slot1 / 2) % BOARD_MAX, y1 = (slot1 / 2) / BOARD_MAX;
+    if (path.min_x == border_w_ + 1 && path.max_x == border_e_ &&
+        border_e_ - border_w_ >= LINE_LENGTH &&
+        (slot0 & 0x1) && (slot1 & 0x1)) {
+      // W edges of the leftmost column and of the column next to rightmost
+      return (x0 == border_w_ + 1 && x1 == border_e_ + 1) ||
+          (x1 == border_w_ + 1 && x0 == border_e_ + 1);
+    }
+    if (path.min_y == border_n_ + 1 && path.max_y == border_s_ &&
+        border_s_ - border_n_ >= LINE_LENGTH &&
+        !(slot0 & 0x1) && !(slot1 & 0x1)) {
+      return (y0 == border_n_ + 1 && y1 == border_s_ + 1) ||
+          (y1 == border_n_ + 1 && y0 == border_s_ + 1);
+    }
     return false;
   }
 
+  /**
+   * Join the two paths of a new tile at (x, y) with the paths of its
+   * neighbors, and detect loops and lines from the joined ends
+   */
+  void LinkPaths(const int x, const int y) {
+    static const PathEnd NOT_END = {-1, COL_CLEAR, 0, 0, 0, 0};
+    int field = GetTileField(x, y);
+    for (int red = 0; red < 2; red++) {
+      int d[2], slots[2], ends[2];
+      bool linked[2];
+      PathEnd path = {-1, (char)(red ? COL_RED : COL_WHITE),
+                      (unsigned char)x, (unsigned char)x,
+                      (unsigned char)y, (unsigned char)y};
+      d[0] = DIR_N;
+      while (((field >> d[0]) & 0x1) != red) d[0]++;
+      d[1] = GetPathExit(field, d[0]);
+      for (int i = 0; i < 2; i++) {
+        slots[i] = GetSlot(x, y, d[i]);
+        linked[i] = IsPlaced(x + GetDX(d[i]), y + GetDY(d[i]));
+        ends[i] = slots[i];
+        if (!linked[i]) continue;
+        const PathEnd &end = paths_[slots[i]];
+        ends[i] = end.other;
+        if (end.min_x < path.min_x) path.min_x = end.min_x;
+        if (end.max_x > path.max_x) path.max_x = end.max_x;
+        if (end.min_y < path.min_y) path.min_y = end.min_y;
+        if (end.max_y > path.max_y) path.max_y = end.max_y;
+      }
+      for (int i = 0; i < 2; i++) {
+        if (linked[i]) SetPathEnd(slots[i], NOT_END);
+      }
+      if (linked[0] && linked[1] && ends[0] == slots[1]) {
+        // Loop found !
+        win_flags_ |= red ? WIN_RED_LOOP : WIN_WHITE_LOOP;
+        continue;
+      }
+      path.other = ends[1];
+      SetPathEnd(ends[0], path);
+      path.other = ends[0];
+      SetPathEnd(ends[1], path);
+      if (IsLine(ends[0], ends[1], path)) {
+        // Line found !
+        win_flags_ |= red ? WIN_RED_LINE : WIN_WHITE_LINE;
+      }
+    }
+  }
+
   /**
    * Set a tile on board
    */
   void SetTile(int x, int y, char shape) {
-    int color = GetColor(x, y, shape);
-    if (shape == '+' && color == COL_WHITE) {
-      blocks_[y][x] = FIELD_PLACED | TILE_RED_NS;
-    } else if (shape == '+' && color == COL_RED) {
-      blocks_[y][x] = FIELD_PLACED | TILE_RED_EW;
-    } else if (shape == '/' && color == COL_WHITE) {
-      blocks_[y][x] = FIELD_PLACED | TILE_RED_WN;
-    } else if (shape == '/' && color == COL_RED) {
-      blocks_[y][x] = FIELD_PLACED | TILE_RED_ES;
-    } else if (shape == '\\' && color == COL_WHITE) {
-      blocks_[y][x] = FIELD_PLACED | TILE_RED_SW;
-    } else if (shape == '\\' && color == COL_RED) {
-      blocks_[y][x] = FIELD_PLACED | TILE_RED_NE;
+    bool is_placed = IsPlaced(x, y);
+    const RuleEntry &rule = GetRuleEntry(GetAroundIndex(x, y));
+    SetBlock(x, y, FIELD_PLACED | rule.tile[GetShapeIndex(shape)]);
+    if (!is_placed) LinkPaths(x, y);
+  }
+
+  /**
+   * Push the empty neighbors of (x, y) to the forced play worklist
+   */
+  inline void PushForcedCandidates(const int x, const int y, int &tail) {
+    for (int d = DIR_N; d <= DIR_W; d++) {
+      int xx = x + GetDX(d), yy = y + GetDY(d);
+      int cell = yy * BOARD_MAX + xx;
+      if (frontier_index_[cell] < 0) continue;
+      Word bit = GetCellBit(xx);
+      if (queued_[yy][xx / WORD_BITS] & bit) continue;
+      queued_[yy][xx / WORD_BITS] |= bit;
+      worklist_[tail] = cell;
+      tail = (tail + 1) % (BOARD_MAX * BOARD_MAX);
+    }
+  }
+
+  /**
+   * Set forced moves caused by a tile at (x, y)
+   * Only the neighbors of newly placed tiles are examined, and each forced
+   * tile is appended to journal_.
+   * Return false if a forced play breaks the rules
+   */
+  bool ScanForced(const int x, const int y) {
+    int head = 0, tail = 0;
+    bool is_valid = true;
+    PushForcedCandidates(x, y, tail);
+    while (head != tail) {
+      int cell = worklist_[head];
+      head = (head + 1) % (BOARD_MAX * BOARD_MAX);
+      int xx = cell % BOARD_MAX, yy = cell / BOARD_MAX;
+      queued_[yy][xx / WORD_BITS] &= ~GetCellBit(xx);
+      if (!is_valid || IsPlaced(xx, yy)) continue;
+      const RuleEntry &rule = GetRuleEntry(GetAroundIndex(xx, yy));
+      if (rule.forced_shape == ' ') continue;
+      if (!((rule.valid_shapes >> GetShapeIndex(rule.forced_shape)) & 0x1)) {
+        // drain the worklist to clear queued_
+        is_valid = false;
+        continue;
+      }
+      SetBlock(xx, yy, FIELD_PLACED | rule.forced_tile);
+      LinkPaths(xx, yy);
+      journal_[journal_size_++] = cell;
+      PushForcedCandidates(xx, yy, tail);
     }
+    return is_valid;
   }
 
   /**
    * Set move on board
+   * Return false if forced plays caused by the move break the rules
    */
   bool SetMove(const int x, const int y, const char shape) {
-    set_move_time_->Start();
+    set_move_time_.Start();
     if (x == border_w_) border_w_--;
     if (y == border_n_) border_n_--;
     if (x > border_e_) border_e_ = x;
     if (y > border_s_) border_s_ = y;
+    win_flags_ = 0;
     SetTile(x, y, shape);
-    // printf("in ScanForced (%d, %d, %c)\n", x, y, shape);
-    ScanForced();
-    set_move_time_->Stop();
-    return true;
+    last_move_ = journal_size_;
+    journal_[journal_size_++] = y * BOARD_MAX + x;
+    bool is_valid = ScanForced(x, y);
+    set_move_time_.Stop();
+    return is_valid;
   }
 
   /**
@@ -521,6 +822,198 @@ class Board {
     return SetMove(m.x + border_w_, m.y + border_n_, m.tile);
   }
 
+  /**
+   * Get a token to take back every move made after this call
+   */
+  UndoToken GetUndoToken() {
+    UndoToken token;
+    token.journal_size = journal_size_;
+    token.path_journal_size = path_journal_.size();
+    token.frontier_journal_size = frontier_journal_.size();
+    token.last_move = last_move_;
+    token.win_flags = win_flags_;
+    token.border_n = border_n_;
+    token.border_e = border_e_;
+    token.border_s = border_s_;
+    token.border_w = border_w_;
+    token.is_valid = true;
+    return token;
+  }
+
+  /**
+   * Set move on board and return a token to take it back
+   */
+  UndoToken MakeMove(const int x, const int y, const char shape) {
+    UndoToken token = GetUndoToken();
+    token.is_valid = SetMove(x, y, shape);
+    return token;
+  }
+
+  /**
+   * Set move on board and return a token to take it back
+   */
+  UndoToken MakeMove(const move m) {
+    return MakeMove(m.x + border_w_, m.y + border_n_, m.tile);
+  }
+
+  /**
+   * Set move on board and return a token to take it back
+   */
+  UndoToken MakeMove(const MoveList::Move m) {
+    int x, y;
+    UnpackMove(m, x, y);
+    return MakeMove(x, y, MoveList::GetShape(m));
+  }
+
+  /**
+   * Take back the move of token and its forced tiles
+   * Tokens must be unmade in reverse order of MakeMove
+   */
+  void UnmakeMove(const UndoToken &token) {
+    const int journal_end = journal_size_;
+    while (journal_size_ > token.journal_size) {
+      int cell = journal_[--journal_size_];
+      WriteBlock(cell % BOARD_MAX, cell / BOARD_MAX, TILE_SPACE);
+    }
+    while ((int)frontier_journal_.size() > token.frontier_journal_size) {
+      UndoFrontier(frontier_journal_.back());
+      frontier_journal_.pop_back();
+    }
+    for (int i = token.journal_size; i < journal_end; i++) {
+      int x = journal_[i] % BOARD_MAX, y = journal_[i] / BOARD_MAX;
+      RefreshValidShapes(x, y);
+      for (int d = DIR_N; d <= DIR_W; d++) {
+        RefreshValidShapes(x + GetDX(d), y + GetDY(d));
+      }
+    }
+    while ((int)path_journal_.size() > token.path_journal_size) {
+      const PathUndo &undo = path_journal_.back();
+      paths_[undo.slot] = undo.end;
+      path_journal_.pop_back();
+    }
+    win_flags_ = token.win_flags;
+    last_move_ = token.last_move;
+    border_n_ = token.border_n;
+    border_e_ = token.border_e;
+    border_s_ = token.border_s;
+    border_w_ = token.border_w;
+  }
+
+  /**
+   * Get the winner color after player's last move, or COL_CLEAR.
+   * If both colors win, player wins.
+   */
+  inline int GetWinner(const int player) {
+    bool red = win_flags_ & (WIN_RED_LOOP | WIN_RED_LINE);
+    bool white = win_flags_ & (WIN_WHITE_LOOP | WIN_WHITE_LINE);
+    if (red && white) return player;
+    return red ? COL_RED : white ? COL_WHITE : COL_CLEAR;
+  }
+
+  /**
+   * Get WinFlag bits made by last move
+   */
+  inline int GetWinFlags() {
+    return win_flags_;
+  }
+
+  /**
+   * Get the empty cell touching the path end at slot
+   */
+  inline void GetEndCell(const int slot, int &x, int &y) {
+    x = (slot / 2) % BOARD_MAX;
+    y = (slot / 2) / BOARD_MAX;
+    if (!IsPlaced(x, y)) return;
+    if (slot & 0x1) {
+      x--;
+    } else {
+      y--;
+    }
+  }
+
+  /**
+   * Score open paths of color minus those of the opposite color.
+   * A path scores for the span of its extent toward a line, and more if
+   * its two ends are close enough to be closed into a loop.
+   */
+  int GetPathBalance(const int color) {
+    int score = 0;
+    for (int i = 0; i < num_frontier_; i++) {
+      int x = frontier_[i] % BOARD_MAX, y = frontier_[i] / BOARD_MAX;
+      for (int d = DIR_N; d <= DIR_W; d++) {
+        if (!IsPlaced(x + GetDX(d), y + GetDY(d))) continue;
+        const PathEnd &end = paths_[GetSlot(x, y, d)];
+        int xx, yy;
+        GetEndCell(end.other, xx, yy);
+        int distance = ((xx > x) ? xx - x : x - xx) +
+            ((yy > y) ? yy - y : y - yy);
+        int span_x = end.max_x - end.min_x, span_y = end.max_y - end.min_y;
+        int path_score = ((span_x > span_y) ? span_x + 1 : span_y + 1) *
+            SPAN_WEIGHT + LOOP_WEIGHT / (distance + 1);
+        score += (end.color == color) ? path_score : -path_score;
+      }
+    }
+    return score;
+  }
+
+  /**
+   * Get position hash relative to the bounding box
+   */
+  inline uint64_t GetHash() {
+    const ZobristTable &table = GetZobristTable();
+    return MixHash(hash_ * table.px_inv[border_w_ + 1] *
+                   table.py_inv[border_n_ + 1]);
+  }
+
+  /**
+   * Get position hash that is also invariant under the 8 board symmetries
+   * and red/white swap, the minimum of the 16 transformed hashes
+   */
+  uint64_t GetCanonicalHash() {
+    const ZobristTable &table = GetZobristTable();
+    static const int SYMMETRIES = 8;
+    uint64_t hashes[SYMMETRIES][2];
+    memset(hashes, 0, sizeof(hashes));
+    int width = border_e_ - border_w_, height = border_s_ - border_n_;
+    for (int y = border_n_ + 1; y <= border_s_; y++) {
+      for (int x = border_w_ + 1; x <= border_e_; x++) {
+        if (!IsPlaced(x, y)) continue;
+        for (int sym = 0; sym < SYMMETRIES; sym++) {
+          int xx = x - border_w_ - 1, yy = y - border_n_ - 1;
+          int field = GetTileField(x, y);
+          TransformTile(sym, width, height, xx, yy, field);
+          hashes[sym][0] += GetZobristKey(table, xx, yy, field);
+          hashes[sym][1] += GetZobristKey(table, xx, yy, field ^ FIELD_TILE);
+        }
+      }
+    }
+    uint64_t canonical = MixHash(hashes[0][0]);
+    for (int sym = 0; sym < SYMMETRIES; sym++) {
+      for (int c = 0; c < 2; c++) {
+        uint64_t h = MixHash(hashes[sym][c]);
+        if (h < canonical) canonical = h;
+      }
+    }
+    return canonical;
+  }
+
+  /**
+   * Get number of forced tiles placed by last SetMove
+   */
+  inline int GetNumForcedTiles() {
+    return (journal_size_ > last_move_) ? journal_size_ - last_move_ - 1 : 0;
+  }
+
+  /**
+   * Get i-th forced tile placed by last SetMove
+   */
+  inline void GetForcedTile(const int i, int &x, int &y, char &shape) {
+    int cell = journal_[last_move_ + 1 + i];
+    x = cell % BOARD_MAX;
+    y = cell / BOARD_MAX;
+    shape = GetTileShape(x, y);
+  }
+
   inline void CheckWhiteLoopPatterns(
       const int x, const int y,
       char &loop_2_s, char &loop_2_n, char &loop_2_e, char &loop_2_w,
@@ -595,7 +1088,7 @@ class Board {
    * If no loop candidate is detected, return TILE_SPACE.
    */
   inline char DetectWhiteLoop(const int x, const int y) {
-    detect_loop_time_->Start();
+    detect_loop_time_.Start();
     char loop_2_s, loop_2_n, loop_2_e, loop_2_w;
     char loop_3_s, loop_3_n, loop_3_e, loop_3_w;
     char ret_tile = TILE_SPACE;
@@ -617,7 +1110,7 @@ class Board {
         break;
       }
     } while (0);
-    detect_loop_time_->Stop();
+    detect_loop_time_.Stop();
     return ret_tile;
   }
 
@@ -661,11 +1154,6 @@ class Board {
         selected_move0.tile = GetTileShape(TILE_RED_EW);
         ret_val = 1;
       }
-      if (loop_2_s || loop_2_e || loop_3_s || loop_3_e ||
-          loop_2_n || loop_2_w || loop_3_n || loop_3_w) {
-        printf("-------- Detect white loop at (%d, %d), checkmate!\n",
-               selected_move0.x, selected_move0.y);
-      }
     } else {
       // Red player defence
       if (loop_2_s) {
@@ -740,11 +1228,6 @@ class Board {
         selected_move1.tile = GetTileShape(TILE_RED_WN);
         ret_val = 2;
       }
-      if (loop_2_s || loop_2_e || loop_3_s || loop_3_e ||
-          loop_2_n || loop_2_w || loop_3_n || loop_3_w) {
-        printf("-------- Detect red loop at (%d, %d), defence!\n",
-               selected_move0.x, selected_move0.y);
-      }
     }
     if (ret_val == 1) return ret_val;
     CheckRedLoopPatterns(x + border_w_, y + border_n_,
@@ -776,11 +1259,6 @@ class Board {
         selected_move0.tile = GetTileShape(TILE_RED_NS);
         ret_val = 1;
       }
-      if (loop_2_s || loop_2_e || loop_3_s || loop_3_e ||
-          loop_2_n || loop_2_w || loop_3_n || loop_3_w) {
-        printf("-------- Detect red loop at (%d, %d), checkmate!\n",
-               selected_move0.x, selected_move0.y);
-      }
     } else {
       // White player defence
       if (loop_2_s) {
@@ -855,11 +1333,6 @@ class Board {
         selected_move1.tile = GetTileShape(TILE_RED_NE);
         ret_val = 2;
       }
-      if (loop_2_s || loop_2_e || loop_3_s || loop_3_e ||
-          loop_2_n || loop_2_w || loop_3_n || loop_3_w) {
-        printf("-------- Detect white loop at (%d, %d), defence!\n",
-               selected_move0.x, selected_move0.y);
-      }
     }
     if (ret_val) return ret_val;
     
@@ -876,7 +1349,7 @@ class Board {
    * If no loop candidate is detected, return TILE_SPACE.
    */
   inline char DetectRedLoop(const int x, const int y) {
-    detect_loop_time_->Start();
+    detect_loop_time_.Start();
     char loop_2_s, loop_2_n, loop_2_e, loop_2_w;
     char loop_3_s, loop_3_n, loop_3_e, loop_3_w;
     char ret_tile = TILE_SPACE;
@@ -888,7 +1361,7 @@ class Board {
     if (loop_2_n || loop_2_w || loop_3_n || loop_3_w) {
       ret_tile = TILE_RED_SW;
     }
-    detect_loop_time_->Stop();
+    detect_loop_time_.Stop();
     return ret_tile;
   }
   
@@ -979,10 +1452,10 @@ class Board {
    * Print profile data
    */
   void PrintProfile() {
-    set_move_time_->PrintTime();
-    is_valid_move_time_->PrintTime();
-    get_around_colors_time_->PrintTime();
-    detect_loop_time_->PrintTime();
+    set_move_time_.PrintTime();
+    is_valid_move_time_.PrintTime();
+    get_around_colors_time_.PrintTime();
+    detect_loop_time_.PrintTime();
   }
 };
 
@@ -1,18 +1,20 @@
-#ifndef BOARD_HPP_
-#define BOARD_HPP_
+#ifndef BOARD_OSANA_HPP_
+#define BOARD_OSANA_HPP_
 
 
 #include <stdio.h>
 #include <string.h>
 
 #include "trax.h"
-#include "timer.hpp"
+#include "rules.hpp"
 
 
 /**
  * Column-major array
+ * The placement rules come from Rules, which reads the board through
+ * GetTileField.
  */
-class Board {
+class BoardOsana : public Rules<BoardOsana> {
  private:
 
   //----------------------------------------------------------------------------
@@ -25,19 +27,6 @@ class Board {
     LINE_LENGTH = 8,
   };
   
-  enum ColorPatterns {
-    COL_CLEAR = 0,
-    COL_WHITE = 1,
-    COL_RED = 2,
-  };
-
-  enum DirectionPatterns {
-    DIR_N = 0,
-    DIR_E = 1,
-    DIR_S = 2,
-    DIR_W = 3,
-  };
-
   enum ValidMoveErrors {
     ERROR_NOT_EMPTY = 1,
     ERROR_CONSISTENT_PLACEMENT = 2,
@@ -56,132 +45,11 @@ class Board {
   char colors_[BOARD_MAX][BOARD_MAX];
   int border_n_, border_e_, border_s_, border_w_;
 
-  Timer *get_around_colors_time_;
-
 
   //----------------------------------------------------------------------------
   // Methods
   //----------------------------------------------------------------------------
 
-  /**
-   * Get opposite color of argument color
-   */
-  inline int GetOppositeColor(const int color) {
-    return (color == COL_WHITE) ? COL_RED :
-        (color == COL_RED) ? COL_WHITE : COL_CLEAR;
-  }
-
-  /**
-   * Get around (N, E, S, W) colors of (x, y)
-   */
-  inline void GetAroundColors(
-      const int x, const int y,
-      int &col_n, int &col_e,
-      int &col_s, int &col_w) {
-    get_around_colors_time_->Start();
-    col_w = colors_[x - 1][y];
-    col_e = (tiles_[x + 1][y] == '+') ? colors_[x + 1][y] :
-        GetOppositeColor(colors_[x + 1][y]);
-    col_n = (tiles_[x][y - 1] == '+') ? GetOppositeColor(colors_[x][y - 1]) :
-        (tiles_[x][y - 1] == '/')  ? colors_[x][y - 1] :
-        GetOppositeColor(colors_[x][y - 1]);
-    col_s = (tiles_[x][y + 1] == '+') ? GetOppositeColor(colors_[x][y + 1]) :
-        (tiles_[x][y + 1] == '\\') ? colors_[x][y + 1] :
-        GetOppositeColor(colors_[x][y + 1]);
-    get_around_colors_time_->Stop();
-  }
-
-  /**
-   * Get (x, y)'s color
-   */
-  inline int GetColor(
-      const char tile,
-      const int col_n, const int col_e,
-      const int col_s, const int col_w) {
-    if (tile == '+') {
-      return (col_w == COL_WHITE || col_e == COL_WHITE ||
-              col_n == COL_RED || col_s == COL_RED) ? COL_WHITE : COL_RED;
-    } else if (tile == '/') {
-      return (col_w == COL_WHITE || col_n == COL_WHITE ||
-              col_s == COL_RED || col_e == COL_RED) ? COL_RED : COL_WHITE;
-    } else if (tile == '\\') {
-      return (col_w == COL_WHITE || col_s == COL_WHITE ||
-              col_n == COL_RED || col_e == COL_RED) ? COL_RED : COL_WHITE;
-    }
-    return COL_CLEAR;
-  }
-
-  /**
-   * Get (x, y)'s color
-   */
-  inline int GetColor(const int x, const int y, const char tile) {
-    int col_n, col_e, col_s, col_w;
-    GetAroundColors(x, y, col_n, col_e, col_s, col_w);
-    return GetColor(tile, col_n, col_e, col_s, col_w);
-  }
-
-  /**
-   * Check whether (x, y) is consistent placement
-   */
-  inline bool IsConsistentPlacement(int x, int y, char tile) {
-    int col_n, col_e, col_s, col_w;
-    GetAroundColors(x, y, col_n, col_e, col_s, col_w);
-    if (tile == '+') {
-      if ((col_w != col_e && (col_w != COL_CLEAR && col_e != COL_CLEAR)) ||
-          (col_n != col_s && (col_n != COL_CLEAR && col_s != COL_CLEAR))) {
-        return false;
-      }
-    }
-    if (tile == '/') {
-      if ((col_w != col_n && (col_w != COL_CLEAR && col_n != COL_CLEAR)) ||
-          (col_s != col_e && (col_s != COL_CLEAR && col_e != COL_CLEAR))) {
-        return false;
-      }
-    }
-    if (tile == '\\') {
-      if ((col_w != col_s && (col_w != COL_CLEAR && col_s != COL_CLEAR)) ||
-          (col_n != col_e && (col_n != COL_CLEAR && col_e != COL_CLEAR))) {
-        return false;
-      }
-    }
-    return true;
-  }
-
-  /**
-   * Check whether (x, y) is line color connected
-   */
-  inline bool IsLineColorConnected(const int x, const int y, const char tile) {
-    int col_n, col_e, col_s, col_w;
-    int my_col_n, my_col_e, my_col_s, my_col_w;
-    GetAroundColors(x, y, col_n, col_e, col_s, col_w);
-    my_col_e = GetColor(x, y, tile);
-    my_col_w = (tile == '+')  ? my_col_e : GetOppositeColor(my_col_e);
-    my_col_n = (tile == '\\') ? my_col_e : GetOppositeColor(my_col_e);
-    my_col_s = (tile == '/')  ? my_col_e : GetOppositeColor(my_col_e);
-    if ((my_col_e != col_e && (col_e != COL_CLEAR)) ||
-        (my_col_w != col_w && (col_w != COL_CLEAR)) ||
-        (my_col_n != col_n && (col_n != COL_CLEAR)) ||
-        (my_col_s != col_s && (col_s != COL_CLEAR))) {
-      return false;
-    }
-    return true;
-  }
-
-  /**
-   * Check whether (x, y) is prohibit pattern
-   */
-  inline bool IsProhibited3(const int x, const int y) {
-    int col_n, col_e, col_s, col_w;
-    GetAroundColors(x, y, col_n, col_e, col_s, col_w);
-    if ((col_w == col_e && col_e == col_n && col_n != COL_CLEAR) ||
-        (col_e == col_n && col_n == col_s && col_s != COL_CLEAR) ||
-        (col_n == col_s && col_s == col_w && col_w != COL_CLEAR) ||
-        (col_s == col_w && col_w == col_e && col_e != COL_CLEAR)) {
-      return true;
-    }
-    return false;
-  }
-
   /**
    * Trace board to find loop
    */
@@ -302,14 +170,6 @@ class Board {
     return found;
   }
 
-  void CreateTimer() {
-    get_around_colors_time_ = new Timer("GetAroundColors");
-  }
-
-  void DestroyTimer() {
-    delete get_around_colors_time_;
-  }
-
 
  public:
 
@@ -329,27 +189,19 @@ class Board {
   /**
    * Constractor
    */
-  Board() :
+  BoardOsana() :
       border_n_(BOARD_CENTER),
       border_e_(BOARD_CENTER),
       border_s_(BOARD_CENTER),
       border_w_(BOARD_CENTER) {
-     for (int x = 0; x < BOARD_MAX; x++) {
+    for (int x = 0; x < BOARD_MAX; x++) {
       for (int y = 0; y < BOARD_MAX; y++) {
         tiles_[x][y] = ' ';
         colors_[x][y] = 0;
       }
-      CreateTimer();
     }
   }
 
-  /**
-   * Destructor
-   */
-  ~Board() {
-    DestroyTimer();
-  }
-
   /**
    * Check whether (x, y) is empty
    */
@@ -395,23 +247,7 @@ class Board {
     for(int y = border_n_; y <= border_s_; y++) {
       for(int x = border_w_; x <= border_e_; x++) {
         if(colors_[x][y] != 0) continue;
-        int col_n, col_e, col_s, col_w;
-        GetAroundColors(x, y, col_n, col_e, col_s, col_w);
-        char forced = ' ';
-        if ((col_w == col_n && col_n != COL_CLEAR) ||
-            (col_s == col_e && col_e != COL_CLEAR)) {
-          forced = '/';
-        }
-        if ((col_e == col_n && col_n != COL_CLEAR) ||
-            (col_s == col_w && col_w != COL_CLEAR)) {
-          forced = '\\';
-        }
-        if ((col_w == col_e && col_e != COL_CLEAR &&
-             col_e != col_s && col_e != col_n) ||
-            (col_n == col_s && col_s != COL_CLEAR &&
-             col_s != col_w && col_s != col_w)) {
-          forced = '+';
-        }
+        char forced = GetForcedShape(x, y);
         if (forced != ' ') {
           SetMove(x, y, forced);
           return true; 
@@ -432,7 +268,6 @@ class Board {
     if (y > border_s_) border_s_ = y;
     tiles_[x][y] = tile;
     colors_[x][y] = GetColor(x, y, tile);
-    printf("SetTile(%d, %d, '%c');\n", x, y, tile);
     ScanForced();
     return true;
   }
@@ -444,6 +279,14 @@ class Board {
     return SetMove(m.x + border_w_, m.y + border_n_, m.tile);
   }
 
+  /**
+   * Get TilePattern of (x, y), TILE_SPACE if empty
+   */
+  inline int GetTileField(const int x, const int y) {
+    return (tiles_[x][y] == ' ') ? (int)TILE_SPACE :
+        GetShapeTile(GetShapeIndex(tiles_[x][y]), colors_[x][y]);
+  }
+
   /**
    * Get tile shape
    */
@@ -480,7 +323,7 @@ class Board {
     border_w_ = left;
   }
 
-  Board& operator=(Board &board) {
+  BoardOsana& operator=(BoardOsana &board) {
     memcpy(this->tiles_, board.tiles_, sizeof(char) * BOARD_MAX * BOARD_MAX);
     memcpy(this->colors_, board.colors_, sizeof(char) * BOARD_MAX * BOARD_MAX);
     this->border_n_ = board.border_n_;
@@ -552,14 +395,7 @@ class Board {
     PrintFullLine();
     printf("\n");
   }
-
-  /**
-   * Print profile data
-   */
-  void PrintProfile() {
-    get_around_colors_time_->PrintTime();
-  }
 };
 
 
-#endif  // end BOARD_HPP_
+#endif  // end BOARD_OSANA_HPP_
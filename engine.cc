@@ -0,0 +1,298 @@
+/*
+   trax-engine: TraxSolver as a child process of a referee
+
+   Usage:
+     trax-engine [-e mode] [-s seed] [-j threads] [-v]
+
+     mode is random, loop (default), search, iterative or mcts, threads
+     the threads of mcts (every core by default) and -v writes what the
+     engine thinks to stderr. The engine speaks a line-based protocol on
+     stdin and stdout, moves in the notation of the referee:
+
+     referee to engine
+       trax                    answered by "id name ..." and "traxok"
+       isready                 answered by "readyok"
+       newgame                 forget the game
+       position [move...]      every move of the game, from the first
+       go [ponder] [time ms]   think the move of the player to move for
+                               ms (1000 by default) and answer
+                               "bestmove move". With ponder, think
+                               without a limit and answer only after
+                               ponderhit or stop.
+       stop                    answer the best move found so far
+       ponderhit               the position pondered on was played,
+                               think for the time of go from now on
+       quit                    exit
+     engine to referee
+       bestmove move
+       info text               anything, ignored by the referee
+
+     Player 1 moves first, so the player to move is known from the
+     number of moves of position. Every go is answered by one bestmove,
+     and a command other than stop, ponderhit and isready coming before
+     it stops the search as stop does.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "trax.h"
+#include "solver.hpp"
+
+
+static const double PONDER_TIME_MS = 1e12;
+
+struct EngineState {
+  int engine;
+  std::string engine_name;
+  uint64_t seed;
+  int num_threads;
+  FILE *stats;  // thinking of the solver, NULL for none
+
+  std::vector<move> position;
+  TraxSolver *solver;  // NULL until the first go of a game
+  int solver_player;
+  std::vector<move> solver_moves;  // moves set on solver
+
+  // A go is answered once, by the thinker or by stop or ponderhit
+  std::mutex mutex;
+  std::condition_variable cond;
+  std::thread thinker, timer;
+  bool answer_pending;
+  bool pondering;
+  bool done;  // Think has returned best
+  move best;
+  double time_ms;
+  bool has_deadline;
+  std::chrono::steady_clock::time_point deadline;
+};
+
+
+static void Print(EngineState &state, const std::string &line) {
+  printf("%s\n", line.c_str());
+  fflush(stdout);
+}
+
+/**
+ * Answer the pending go with best, state.mutex must be held
+ */
+static void AnswerBestMove(EngineState &state) {
+  char buf[move::MAX_LENGTH];
+  state.best.format(buf, sizeof(buf));
+  Print(state, std::string("bestmove ") + buf);
+  state.answer_pending = false;
+}
+
+static void Think(EngineState *state) {
+  move best = state->solver->Think();
+  std::lock_guard<std::mutex> lock(state->mutex);
+  state->solver_moves.push_back(best);
+  state->best = best;
+  state->done = true;
+  if (state->answer_pending && !state->pondering) AnswerBestMove(*state);
+  state->cond.notify_all();
+}
+
+/**
+ * Stop a search turned from pondering to thinking at its deadline
+ */
+static void WaitDeadline(EngineState *state) {
+  std::unique_lock<std::mutex> lock(state->mutex);
+  while (!state->done) {
+    if (!state->has_deadline) {
+      state->cond.wait(lock);
+    } else if (state->cond.wait_until(lock, state->deadline) ==
+               std::cv_status::timeout) {
+      if (!state->done) state->solver->Stop();
+      break;
+    }
+  }
+}
+
+static void Stop(EngineState &state) {
+  std::lock_guard<std::mutex> lock(state.mutex);
+  if (!state.answer_pending) return;
+  state.pondering = false;
+  if (state.done) {
+    AnswerBestMove(state);
+  } else {
+    state.solver->Stop();
+  }
+}
+
+/**
+ * Stop the search, as stop does, and wait for its threads
+ */
+static void Finish(EngineState &state) {
+  Stop(state);
+  if (state.thinker.joinable()) state.thinker.join();
+  if (state.timer.joinable()) state.timer.join();
+}
+
+static void NewGame(EngineState &state) {
+  Finish(state);
+  delete state.solver;
+  state.solver = NULL;
+  state.solver_moves.clear();
+  state.position.clear();
+}
+
+/**
+ * Bring the solver to position with player to move, from scratch unless
+ * position follows the moves already set
+ */
+static void SetPosition(EngineState &state, const int player) {
+  const std::vector<move> &moves = state.position;
+  bool follows = state.solver && state.solver_player == player &&
+      state.solver_moves.size() <= moves.size();
+  for (size_t i = 0; follows && i < state.solver_moves.size(); i++) {
+    char a[move::MAX_LENGTH], b[move::MAX_LENGTH];
+    state.solver_moves[i].format(a, sizeof(a));
+    moves[i].format(b, sizeof(b));
+    follows = (strcmp(a, b) == 0);
+  }
+  if (!follows) {
+    delete state.solver;
+    state.solver = new TraxSolver(player, state.engine, state.seed++);
+    state.solver->SetNumThreads(state.num_threads);
+    state.solver->SetStatsFile(state.stats);
+    state.solver_player = player;
+    state.solver_moves.clear();
+  }
+  for (size_t i = state.solver_moves.size(); i < moves.size(); i++) {
+    state.solver->SetMove(moves[i]);
+    state.solver_moves.push_back(moves[i]);
+  }
+}
+
+static void Go(EngineState &state, std::istringstream &args) {
+  Finish(state);
+  bool ponder = false;
+  double time_ms = 1000;
+  std::string arg;
+  while (args >> arg) {
+    if (arg == "ponder") ponder = true;
+    if (arg == "time") args >> time_ms;
+  }
+
+  std::lock_guard<std::mutex> lock(state.mutex);
+  state.answer_pending = true;
+  state.pondering = ponder;
+  state.done = false;
+  state.time_ms = time_ms;
+  state.has_deadline = false;
+  if (state.position.empty()) {
+    // the first move, as TraxSolver::MyTurn
+    state.best = move(FIRST_MOVE_1);
+    state.done = true;
+    if (!ponder) AnswerBestMove(state);
+    return;
+  }
+  SetPosition(state, (state.position.size() % 2 == 0) ? 1 : 2);
+  state.solver->Stop(false);
+  state.solver->SetThinkTime(ponder ? PONDER_TIME_MS : time_ms);
+  state.thinker = std::thread(Think, &state);
+  if (ponder) state.timer = std::thread(WaitDeadline, &state);
+}
+
+static void PonderHit(EngineState &state) {
+  std::lock_guard<std::mutex> lock(state.mutex);
+  if (!state.answer_pending || !state.pondering) return;
+  state.pondering = false;
+  if (state.done) {
+    AnswerBestMove(state);
+    return;
+  }
+  state.has_deadline = true;
+  state.deadline = std::chrono::steady_clock::now() +
+      std::chrono::microseconds((long long)(state.time_ms * 1000));
+  state.cond.notify_all();
+}
+
+static void Usage() {
+  fprintf(stderr, "usage: trax-engine [-e mode] [-s seed] [-j threads] "
+          "[-v]\n"
+          "  mode: random, loop, search, iterative or mcts\n");
+  exit(1);
+}
+
+
+int main(int argc, char *argv[]) {
+  EngineState state;
+  state.engine = TraxSolver::ENGINE_LOOP_ATACK;
+  state.engine_name = "loop";
+  state.seed = time(0);
+  state.num_threads = 0;
+  state.solver = NULL;
+  state.solver_player = 0;
+  state.answer_pending = false;
+  state.pondering = false;
+  state.done = false;
+  state.time_ms = 0;
+  state.has_deadline = false;
+  state.stats = NULL;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+      state.engine_name = argv[++i];
+      state.engine = TraxSolver::GetEngineMode(state.engine_name);
+      if (state.engine < 0) Usage();
+    } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+      state.seed = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+      state.num_threads = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-v") == 0) {
+      state.stats = stderr;
+    } else {
+      Usage();
+    }
+  }
+
+  std::string line;
+  while (std::getline(std::cin, line)) {
+    std::istringstream args(line);
+    std::string command;
+    if (!(args >> command)) continue;
+    if (command == "trax") {
+      Print(state, "id name trax-engine " + state.engine_name);
+      Print(state, "traxok");
+    } else if (command == "isready") {
+      Print(state, "readyok");
+    } else if (command == "newgame") {
+      NewGame(state);
+    } else if (command == "position") {
+      std::string rest;
+      std::getline(args, rest);
+      std::vector<move> moves(rest.length() / 2 + 1);
+      int num = move::parse_line(rest.data(), rest.length(), &moves[0],
+                                 moves.size());
+      if (num < 0) {
+        Print(state, "info cannot parse position");
+        continue;
+      }
+      Finish(state);
+      state.position.assign(moves.begin(), moves.begin() + num);
+    } else if (command == "go") {
+      Go(state, args);
+    } else if (command == "stop") {
+      Stop(state);
+    } else if (command == "ponderhit") {
+      PonderHit(state);
+    } else if (command == "quit") {
+      break;
+    } else {
+      Print(state, "info unknown command " + command);
+    }
+  }
+  Finish(state);
+  delete state.solver;
+  return 0;
+}
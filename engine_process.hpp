@@ -0,0 +1,274 @@
+#ifndef ENGINE_PROCESS_HPP_
+#define ENGINE_PROCESS_HPP_
+
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "trax.h"
+#include "timer.hpp"
+
+
+/**
+ * Engine run as a child process and driven through pipes, in the
+ * protocol of trax-engine (see engine.cc)
+ */
+class EngineProcess {
+ private:
+
+  //----------------------------------------------------------------------------
+  // Typedefs and Constants
+  //----------------------------------------------------------------------------
+
+  enum Timeout {
+    START_TIMEOUT_MS = 5000,  // of the first answer
+    READY_TIMEOUT_MS = 5000,
+    STOP_MARGIN_MS = 500,     // after the time of go, before stop
+    STOP_GRACE_MS = 1000,     // after stop, before giving up
+    QUIT_TIMEOUT_MS = 1000,   // after quit, before kill
+  };
+
+
+  //----------------------------------------------------------------------------
+  // Members
+  //----------------------------------------------------------------------------
+
+  pid_t pid_;
+  int to_fd_;      // stdin of the engine
+  int from_fd_;    // stdout of the engine
+  std::string buffer_;  // read but not yet returned by ReadLine
+
+
+  //----------------------------------------------------------------------------
+  // Methods
+  //----------------------------------------------------------------------------
+
+  /**
+   * Engines are started one at a time, so that no child inherits the
+   * pipes of another engine before they are marked close-on-exec
+   */
+  static std::mutex &GetStartMutex() {
+    static std::mutex mutex;
+    return mutex;
+  }
+
+  /**
+   * Read lines until one starts with prefix
+   */
+  bool Expect(const std::string &prefix, const double timeout_ms,
+              std::string &line) {
+    const double deadline = GetMonotonicTimeMs() + timeout_ms;
+    while (ReadLine(line, deadline - GetMonotonicTimeMs())) {
+      if (line.compare(0, prefix.length(), prefix) == 0) return true;
+    }
+    return false;
+  }
+
+
+ public:
+
+  //----------------------------------------------------------------------------
+  // Methods
+  //----------------------------------------------------------------------------
+
+  /**
+   * Constractor
+   */
+  EngineProcess() : pid_(-1), to_fd_(-1), from_fd_(-1) {}
+
+  /**
+   * Destructor
+   */
+  ~EngineProcess() {
+    Close();
+  }
+
+  /**
+   * Run command by /bin/sh and wait for its answer to "trax"
+   * Return false if it cannot be run or does not answer
+   */
+  bool Start(const std::string &command) {
+    Close();
+    signal(SIGPIPE, SIG_IGN);  // a dead engine is found by Send
+    {
+      std::lock_guard<std::mutex> lock(GetStartMutex());
+      int to[2], from[2];
+      if (pipe(to) != 0) return false;
+      if (pipe(from) != 0) {
+        close(to[0]);
+        close(to[1]);
+        return false;
+      }
+      fcntl(to[1], F_SETFD, FD_CLOEXEC);
+      fcntl(from[0], F_SETFD, FD_CLOEXEC);
+      pid_ = fork();
+      if (pid_ == 0) {
+        dup2(to[0], STDIN_FILENO);
+        dup2(from[1], STDOUT_FILENO);
+        close(to[0]);
+        close(to[1]);
+        close(from[0]);
+        close(from[1]);
+        execl("/bin/sh", "sh", "-c", command.c_str(), (char *)NULL);
+        _exit(127);
+      }
+      close(to[0]);
+      close(from[1]);
+      to_fd_ = to[1];
+      from_fd_ = from[0];
+      if (pid_ < 0) {
+        Close();
+        return false;
+      }
+    }
+    std::string line;
+    return Send("trax") && Expect("traxok", START_TIMEOUT_MS, line);
+  }
+
+  /**
+   * Send a line to the engine
+   */
+  bool Send(const std::string &line) {
+    if (to_fd_ < 0) return false;
+    std::string data = line + "\n";
+    size_t sent = 0;
+    while (sent < data.length()) {
+      ssize_t n = write(to_fd_, data.data() + sent, data.length() - sent);
+      if (n <= 0) return false;
+      sent += n;
+    }
+    return true;
+  }
+
+  /**
+   * Read a line from the engine, without its newline
+   * Return false on timeout or when the engine has exited
+   */
+  bool ReadLine(std::string &line, const double timeout_ms) {
+    const double deadline = GetMonotonicTimeMs() + timeout_ms;
+    size_t newline;
+    while ((newline = buffer_.find('\n')) == std::string::npos) {
+      double remaining = deadline - GetMonotonicTimeMs();
+      if (from_fd_ < 0 || remaining <= 0) return false;
+      struct pollfd pfd;
+      pfd.fd = from_fd_;
+      pfd.events = POLLIN;
+      int ready = poll(&pfd, 1, (int)remaining + 1);
+      if (ready < 0) return false;
+      if (ready == 0) continue;
+      char buf[4096];
+      ssize_t n = read(from_fd_, buf, sizeof(buf));
+      if (n <= 0) return false;
+      buffer_.append(buf, n);
+    }
+    line = buffer_.substr(0, newline);
+    buffer_.erase(0, newline + 1);
+    if (!line.empty() && line[line.length() - 1] == '\r') {
+      line.erase(line.length() - 1);
+    }
+    return true;
+  }
+
+  /**
+   * Start a new game and wait until the engine is ready
+   */
+  bool NewGame() {
+    std::string line;
+    return Send("newgame") && Send("isready") &&
+        Expect("readyok", READY_TIMEOUT_MS, line);
+  }
+
+  /**
+   * Send every move of the game
+   */
+  bool Position(const std::vector<move> &moves) {
+    std::string line = "position";
+    char buf[move::MAX_LENGTH];
+    for (size_t i = 0; i < moves.size(); i++) {
+      moves[i].format(buf, sizeof(buf));
+      line += ' ';
+      line += buf;
+    }
+    return Send(line);
+  }
+
+  /**
+   * Wait for the answer to go
+   */
+  bool WaitBestMove(const double timeout_ms, move &best) {
+    std::string line;
+    if (!Expect("bestmove ", timeout_ms, line)) return false;
+    return best.parse(line.data() + 9, line.length() - 9);
+  }
+
+  /**
+   * Think the move after moves for time_ms
+   * Return false if the engine does not answer even after stop
+   */
+  bool Go(const std::vector<move> &moves, const double time_ms,
+          move &best) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "go time %.0f", time_ms);
+    if (!Position(moves) || !Send(buf)) return false;
+    return WaitBestMove(time_ms + STOP_MARGIN_MS, best) || Stop(best);
+  }
+
+  /**
+   * Think on the opponent's time, moves ending with the expected move
+   * of the opponent. Follow with PonderHit if it is played, or Stop.
+   */
+  bool Ponder(const std::vector<move> &moves, const double time_ms) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "go ponder time %.0f", time_ms);
+    return Position(moves) && Send(buf);
+  }
+
+  /**
+   * The expected move was played, wait for the move of the ponder
+   */
+  bool PonderHit(const double time_ms, move &best) {
+    if (!Send("ponderhit")) return false;
+    return WaitBestMove(time_ms + STOP_MARGIN_MS, best) || Stop(best);
+  }
+
+  /**
+   * Stop thinking and get the best move so far
+   */
+  bool Stop(move &best) {
+    return Send("stop") && WaitBestMove(STOP_GRACE_MS, best);
+  }
+
+  /**
+   * Quit the engine, killing it if it does not exit
+   */
+  void Close() {
+    if (pid_ > 0) {
+      Send("quit");
+      const double deadline = GetMonotonicTimeMs() + QUIT_TIMEOUT_MS;
+      while (waitpid(pid_, NULL, WNOHANG) == 0) {
+        if (GetMonotonicTimeMs() >= deadline) {
+          kill(pid_, SIGKILL);
+          waitpid(pid_, NULL, 0);
+          break;
+        }
+        usleep(1000);
+      }
+    }
+    if (to_fd_ >= 0) close(to_fd_);
+    if (from_fd_ >= 0) close(from_fd_);
+    pid_ = -1;
+    to_fd_ = from_fd_ = -1;
+    buffer_.clear();
+  }
+};
+
+
+#endif  // end ENGINE_PROCESS_HPP_
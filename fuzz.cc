@@ -0,0 +1,200 @@
+/*
+   Differential fuzzing of the rules
+
+   Usage:
+     trax -f [-n games] [-s seed]
+
+     Plays random games on the referee (trax), Board and BoardOsana,
+     which share the rules of rules.hpp on three storages, and checks
+     after every move that they agree on legal shapes, on whether the
+     move is a violation, on every tile and color, and on wins. Now and
+     then a shape is picked at random for a cell next to a tile, legal or
+     not, so that violations are played as well. The first disagreement
+     is printed with the moves of its game and the exit status is 1.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "trax.h"
+#include "board.hpp"
+#include "board_osana.hpp"
+#include "move_list.hpp"
+#include "timer.hpp"
+#include "xoshiro.hpp"
+
+// Board with its tiles readable from outside
+class fuzz_board : public Board {
+public:
+  using Board::GetTileField;
+};
+
+struct fuzz_stats {
+  int games, moves, violations, wins;
+};
+
+static const int MAX_MOVES = 200;
+static const int MAX_SPAN = trax::BOARD_MAX/2 - 4;
+static const char SHAPES[3] = {'+', '/', '\\'};
+
+
+static void print_game(const std::vector<move>& moves){
+  char buf[move::MAX_LENGTH];
+  for(size_t i=0; i<moves.size(); i++){
+    moves[i].format(buf, sizeof(buf));
+    fprintf(stderr, "%s%c", buf, (i+1<moves.size()) ? ' ' : '\n');
+  }
+}
+
+// Empty string if the three agree on every cell of the bounding box
+static std::string compare_tiles(trax& ref, fuzz_board& board,
+                                 BoardOsana& osana){
+  char buf[64];
+  if(board.left!=osana.left || board.right!=osana.right ||
+     board.top!=osana.top || board.bottom!=osana.bottom){
+    return "bounding box of Board and BoardOsana";
+  }
+  for(int y=board.top; y<=board.bottom; y++){
+    for(int x=board.left; x<=board.right; x++){
+      int r = ref.GetTileField(x, y);
+      int b = board.GetTileField(x, y);
+      int o = osana.GetTileField(x, y);
+      if(r!=b || b!=o){
+        snprintf(buf, sizeof(buf), "tile at (%d, %d): %x %x %x",
+                 x-board.left, y-board.top, r, b, o);
+        return buf;
+      }
+    }
+  }
+  return "";
+}
+
+// Play one game, return an empty string or what went wrong
+static std::string fuzz_game(Xoshiro256& rng, std::vector<move>& moves,
+                             fuzz_stats& stats){
+  trax ref;
+  fuzz_board* board = new fuzz_board();
+  BoardOsana* osana = new BoardOsana();
+  std::string error;
+  MoveList legal;
+  char buf[64];
+
+  ref.clear_board();
+  moves.clear();
+  stats.games++;
+
+  for(int i=0; i<MAX_MOVES && error.empty(); i++){
+    move mo;
+    mo.x = mo.y = 0;
+    mo.tile = SHAPES[rng.GetRange(3)];
+    if(i > 0){
+      board->GatherMoves(legal);
+      if(legal.GetSize()==0) break;
+      if(rng.GetRange(8)==0){
+        int fx, fy, valid_shapes;
+        board->GetFrontier(rng.GetRange(board->GetNumFrontier()),
+                           fx, fy, valid_shapes);
+        mo.x = fx - board->left;
+        mo.y = fy - board->top;
+      } else {
+        mo = board->ToMove(legal[rng.GetRange(legal.GetSize())]);
+      }
+    }
+    if(board->right-board->left > MAX_SPAN ||
+       board->bottom-board->top > MAX_SPAN) break;
+    moves.push_back(mo);
+    stats.moves++;
+
+    // legal shapes of the cell, from each storage
+    int x = board->left + mo.x, y = board->top + mo.y;
+    int r = ref.GetValidShapes(x, y);
+    int b = board->GetValidShapes(x, y);
+    int o = osana->GetValidShapes(x, y);
+    if(r!=b || b!=o){
+      snprintf(buf, sizeof(buf), "legal shapes: %d %d %d", r, b, o);
+      error = buf;
+      break;
+    }
+
+    // the move itself, forced plays included
+    bool ref_valid = ref.place(mo) && ref.is_board_consistent();
+    bool board_valid = board->IsValidMove(mo) && board->SetMove(mo);
+    if(ref_valid != board_valid){
+      snprintf(buf, sizeof(buf), "violation: referee %d Board %d",
+               !ref_valid, !board_valid);
+      error = buf;
+      break;
+    }
+    if(!ref_valid){
+      stats.violations++;
+      break;
+    }
+    osana->SetMove(mo);
+    ref.clear_marks();
+
+    error = compare_tiles(ref, *board, *osana);
+    if(!error.empty()) break;
+
+    int flags = board->GetWinFlags();
+    bool loop = flags & (Board::WIN_WHITE_LOOP | Board::WIN_RED_LOOP);
+    bool line = flags & (Board::WIN_WHITE_LINE | Board::WIN_RED_LINE);
+    bool red = flags & (Board::WIN_RED_LOOP | Board::WIN_RED_LINE);
+    bool white = flags & (Board::WIN_WHITE_LOOP | Board::WIN_WHITE_LINE);
+    if(loop!=ref.loop() || line!=ref.line() ||
+       red!=ref.red() || white!=ref.white()){
+      snprintf(buf, sizeof(buf),
+               "win flags: referee %d%d%d%d Board %d%d%d%d",
+               ref.loop(), ref.line(), ref.red(), ref.white(),
+               loop, line, red, white);
+      error = buf;
+      break;
+    }
+    if(flags){
+      stats.wins++;
+      break;
+    }
+  }
+
+  delete board;
+  delete osana;
+  return error;
+}
+
+int fuzz_main(int argc, char* argv[]){
+  int num_games = 1000;
+  uint64_t seed = 1;
+
+  for(int i=0; i<argc; i++){
+    if(strcmp(argv[i], "-n")==0 && i+1<argc){
+      num_games = atoi(argv[++i]);
+    } else if(strcmp(argv[i], "-s")==0 && i+1<argc){
+      seed = strtoull(argv[++i], 0, 10);
+    } else {
+      fprintf(stderr, "usage: trax -f [-n games] [-s seed]\n");
+      return 1;
+    }
+  }
+
+  double start = GetMonotonicTimeMs();
+  Xoshiro256 rng(seed);
+  fuzz_stats stats = {0, 0, 0, 0};
+  std::vector<move> moves;
+  for(int g=0; g<num_games; g++){
+    std::string error = fuzz_game(rng, moves, stats);
+    if(!error.empty()){
+      char buf[move::MAX_LENGTH];
+      moves.back().format(buf, sizeof(buf));
+      fprintf(stderr, "game %d, move %d (%s): %s\n", g, (int)moves.size(),
+              buf, error.c_str());
+      print_game(moves);
+      return 1;
+    }
+  }
+  fprintf(stderr, "%d games, %d moves, %d violations, %d wins, %.1f ms\n",
+          stats.games, stats.moves, stats.violations, stats.wins,
+          GetMonotonicTimeMs() - start);
+  return 0;
+}
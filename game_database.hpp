@@ -0,0 +1,320 @@
+#ifndef GAME_DATABASE_HPP_
+#define GAME_DATABASE_HPP_
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+
+#include "trax.h"
+
+
+/**
+ * Binary container of game records, in host byte order.
+ *   Header      at 0
+ *   game blobs  moves (uint16_t each) then metadata text, 8 byte aligned
+ *   GameEntry[] index of every game at header.index_offset
+ * A move is packed in 16 bits, x in [15:9], y in [8:2] and the shape id
+ * (0: '+', 1: '/', 2: '\') in [1:0], relative to the bounding box as in
+ * the notation.
+ */
+class GameDatabase {
+ public:
+
+  //----------------------------------------------------------------------------
+  // Typedefs and Constants
+  //----------------------------------------------------------------------------
+
+  typedef uint16_t PackedMove;
+
+  enum Restriction {
+    VERSION   = 1,
+    MAX_COORD = 127,  // x and y of a packed move
+    ALIGNMENT = 8,
+  };
+
+  enum ResultType {
+    RESULT_NONE      = 0,  // game not over
+    RESULT_LOOP      = 1,
+    RESULT_LINE      = 2,
+    RESULT_VIOLATION = 3,  // winner is the opponent of the violator
+  };
+
+  struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t num_games;
+    uint64_t index_offset;
+  };
+
+  struct GameEntry {
+    uint64_t offset;        // file offset of the moves
+    uint32_t num_moves;
+    uint32_t result_move;   // index of the move ending the game
+    uint16_t meta_length;   // bytes of metadata after the moves
+    uint8_t winner;         // 0: none, 1: white, 2: red
+    uint8_t result_type;    // ResultType
+    uint32_t reserved;
+  };
+
+  static const char *GetMagic() {
+    return "TRAXDB\0\0";
+  }
+
+  static inline PackedMove PackMove(const move &m) {
+    int shape_id = (m.tile == '+') ? 0 : (m.tile == '/') ? 1 : 2;
+    return (PackedMove)((m.x << 9) | (m.y << 2) | shape_id);
+  }
+
+  static inline move UnpackMove(const PackedMove packed) {
+    move m;
+    m.x = packed >> 9;
+    m.y = (packed >> 2) & MAX_COORD;
+    m.tile = ((packed & 0x3) == 0) ? '+' : ((packed & 0x3) == 1) ? '/' : '\\';
+    return m;
+  }
+
+
+ private:
+
+  //----------------------------------------------------------------------------
+  // Members
+  //----------------------------------------------------------------------------
+
+  const char *data_;
+  size_t size_;
+  const Header *header_;
+  const GameEntry *index_;
+
+
+ public:
+
+  //----------------------------------------------------------------------------
+  // Methods
+  //----------------------------------------------------------------------------
+
+  /**
+   * Constractor
+   */
+  GameDatabase() :
+      data_(NULL),
+      size_(0),
+      header_(NULL),
+      index_(NULL) {}
+
+  ~GameDatabase() {
+    Close();
+  }
+
+  /**
+   * Map a container read-only and check its header and index
+   * Return false on error
+   */
+  bool Open(const char *filename) {
+    Close();
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(Header)) {
+      close(fd);
+      return false;
+    }
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return false;
+    data_ = (const char *)data;
+    size_ = st.st_size;
+    header_ = (const Header *)data_;
+    if (memcmp(header_->magic, GetMagic(), sizeof(header_->magic)) != 0 ||
+        header_->version != VERSION ||
+        header_->index_offset % ALIGNMENT != 0 ||
+        header_->index_offset > size_ ||
+        (size_ - header_->index_offset) / sizeof(GameEntry) <
+        header_->num_games) {
+      Close();
+      return false;
+    }
+    index_ = (const GameEntry *)(data_ + header_->index_offset);
+    for (uint32_t i = 0; i < header_->num_games; i++) {
+      const GameEntry &entry = index_[i];
+      if (entry.offset % ALIGNMENT != 0 ||
+          entry.offset + entry.num_moves * sizeof(PackedMove) +
+          entry.meta_length > header_->index_offset) {
+        Close();
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void Close() {
+    if (data_) munmap((void *)data_, size_);
+    data_ = NULL;
+    size_ = 0;
+    header_ = NULL;
+    index_ = NULL;
+  }
+
+  int GetNumGames() const {
+    return header_ ? header_->num_games : 0;
+  }
+
+  const GameEntry &GetGame(const int game) const {
+    return index_[game];
+  }
+
+  /**
+   * Get the moves of game, pointing into the mapping
+   */
+  const PackedMove *GetMoves(const int game) const {
+    return (const PackedMove *)(data_ + index_[game].offset);
+  }
+
+  move GetMove(const int game, const int i) const {
+    return UnpackMove(GetMoves(game)[i]);
+  }
+
+  /**
+   * Get the metadata text of game, not NUL-terminated
+   */
+  const char *GetMetadata(const int game, int &length) const {
+    length = index_[game].meta_length;
+    return (const char *)(GetMoves(game) + index_[game].num_moves);
+  }
+};
+
+
+/**
+ * Sequential writer of a GameDatabase container
+ */
+class GameDatabaseWriter {
+ private:
+
+  //----------------------------------------------------------------------------
+  // Members
+  //----------------------------------------------------------------------------
+
+  FILE *fp_;
+  uint64_t offset_;
+  std::vector<GameDatabase::GameEntry> index_;
+
+
+  //----------------------------------------------------------------------------
+  // Methods
+  //----------------------------------------------------------------------------
+
+  bool Write(const void *data, const size_t size) {
+    if (size && fwrite(data, 1, size, fp_) != size) return false;
+    offset_ += size;
+    return true;
+  }
+
+  bool Align() {
+    static const char ZEROS[GameDatabase::ALIGNMENT] = {0};
+    return Write(ZEROS, (GameDatabase::ALIGNMENT -
+                         offset_ % GameDatabase::ALIGNMENT) %
+                 GameDatabase::ALIGNMENT);
+  }
+
+  GameDatabase::Header GetHeader(const uint64_t index_offset) {
+    GameDatabase::Header header;
+    memcpy(header.magic, GameDatabase::GetMagic(), sizeof(header.magic));
+    header.version = GameDatabase::VERSION;
+    header.num_games = index_.size();
+    header.index_offset = index_offset;
+    return header;
+  }
+
+
+ public:
+
+  //----------------------------------------------------------------------------
+  // Methods
+  //----------------------------------------------------------------------------
+
+  /**
+   * Constractor
+   */
+  GameDatabaseWriter() :
+      fp_(NULL),
+      offset_(0) {}
+
+  ~GameDatabaseWriter() {
+    if (fp_) fclose(fp_);
+  }
+
+  /**
+   * Create filename, return false on error
+   */
+  bool Open(const char *filename) {
+    fp_ = fopen(filename, "wb");
+    if (!fp_) return false;
+    offset_ = 0;
+    index_.clear();
+    GameDatabase::Header header = GetHeader(0);
+    return Write(&header, sizeof(header)) && Align();
+  }
+
+  /**
+   * Every move is in the packed range, so the game can be added
+   */
+  static bool CanPack(const std::vector<move> &moves) {
+    for (size_t i = 0; i < moves.size(); i++) {
+      if (moves[i].x < 0 || moves[i].x > GameDatabase::MAX_COORD ||
+          moves[i].y < 0 || moves[i].y > GameDatabase::MAX_COORD) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /**
+   * Append a game, whose moves must be CanPack
+   * Return false on a write error
+   */
+  bool AddGame(const std::vector<move> &moves, const std::string &metadata,
+               const int winner, const int result_type,
+               const int result_move) {
+    GameDatabase::GameEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.offset = offset_;
+    entry.num_moves = moves.size();
+    entry.result_move = result_move;
+    entry.meta_length = (metadata.size() < 0xffff) ? metadata.size() : 0xffff;
+    entry.winner = winner;
+    entry.result_type = result_type;
+    std::vector<GameDatabase::PackedMove> packed(moves.size());
+    for (size_t i = 0; i < moves.size(); i++) {
+      packed[i] = GameDatabase::PackMove(moves[i]);
+    }
+    if (!Write(packed.data(), packed.size() * sizeof(packed[0])) ||
+        !Write(metadata.data(), entry.meta_length) || !Align()) {
+      return false;
+    }
+    index_.push_back(entry);
+    return true;
+  }
+
+  /**
+   * Write the index and the header, return false on error
+   */
+  bool Close() {
+    uint64_t index_offset = offset_;
+    GameDatabase::Header header = GetHeader(index_offset);
+    bool ok = Write(index_.data(), index_.size() * sizeof(index_[0])) &&
+        fseek(fp_, 0, SEEK_SET) == 0 &&
+        fwrite(&header, sizeof(header), 1, fp_) == 1;
+    ok = (fclose(fp_) == 0) && ok;
+    fp_ = NULL;
+    return ok;
+  }
+};
+
+
+#endif  // end GAME_DATABASE_HPP_
@@ -0,0 +1,326 @@
+#ifndef MCTS_HPP_
+#define MCTS_HPP_
+
+
+#include <stdio.h>
+#include <math.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "board.hpp"
+#include "move_list.hpp"
+#include "playout.hpp"
+#include "timer.hpp"
+
+
+/**
+ * Tree-parallel Monte Carlo tree search with UCT selection.
+ * Every thread walks the shared tree on its own copy of the root board.
+ * Node statistics are atomics, and a virtual loss steers concurrent
+ * threads away from the path another thread is working on.
+ */
+class MonteCarloTreeSearch {
+ private:
+
+  //----------------------------------------------------------------------------
+  // Typedefs and Constants
+  //----------------------------------------------------------------------------
+
+  enum NodeState {
+    NODE_LEAF      = 0,
+    NODE_EXPANDING = 1,  // a thread is creating its children
+    NODE_EXPANDED  = 2,
+  };
+
+  enum Restriction {
+    VIRTUAL_LOSS      = 1,
+  };
+
+  /**
+   * Score of a playout, 2 for a win and 1 for a draw
+   */
+  enum PlayoutScore {
+    SCORE_LOSS = 0,
+    SCORE_DRAW = 1,
+    SCORE_WIN  = 2,
+  };
+
+  /**
+   * Node reached by a move of mover. Statistics are from mover's side.
+   */
+  struct Node {
+    std::atomic<int> visits;
+    std::atomic<int> score;          // sum of PlayoutScore
+    std::atomic<int> virtual_loss;
+    std::atomic<int> state;          // NodeState
+    int first_child;
+    int num_children;
+    MoveList::Move move;
+    char mover;
+    char winner;                     // winner after the move, 0 if none
+  };
+
+  static constexpr double UCT_C = 1.0;
+
+
+  //----------------------------------------------------------------------------
+  // Members
+  //----------------------------------------------------------------------------
+
+  Node *nodes_;
+  int capacity_;
+  std::atomic<int> num_nodes_;
+  std::atomic<long long> num_playouts_;
+  double deadline_;  // ms of GetMonotonicTimeMs
+  const std::atomic<bool> *stop_;  // stops the search when set, or NULL
+  FILE *stats_;  // reports of every search, or NULL
+
+
+  //----------------------------------------------------------------------------
+  // Methods
+  //----------------------------------------------------------------------------
+
+  static inline int GetOpponent(const int player) {
+    return (player == 1) ? 2 : 1;
+  }
+
+  /**
+   * Take num nodes from the pool, return -1 if the pool is exhausted
+   */
+  int AllocateNodes(const int num) {
+    int first = num_nodes_.fetch_add(num, std::memory_order_relaxed);
+    if (first + num > capacity_) return -1;
+    return first;
+  }
+
+  void InitializeNode(Node &node, const MoveList::Move m, const int mover,
+                      const int winner) {
+    node.visits.store(0, std::memory_order_relaxed);
+    node.score.store(0, std::memory_order_relaxed);
+    node.virtual_loss.store(0, std::memory_order_relaxed);
+    node.state.store(NODE_LEAF, std::memory_order_relaxed);
+    node.first_child = -1;
+    node.num_children = 0;
+    node.move = m;
+    node.mover = mover;
+    node.winner = winner;
+  }
+
+  /**
+   * Create children of node for every legal move of player on board.
+   * Each move is made with its forced plays, moves whose forced plays
+   * break the rules are dropped.
+   * Return false if another thread is expanding node or the pool is full.
+   */
+  bool Expand(Node &node, Board &board, const int player) {
+    int expected = NODE_LEAF;
+    if (!node.state.compare_exchange_strong(expected, NODE_EXPANDING,
+                                            std::memory_order_acquire)) {
+      return false;
+    }
+    // gather first, the frontier order changes with MakeMove
+    MoveList candidates;
+    board.GatherMoves(candidates);
+    int first = AllocateNodes(candidates.GetSize());
+    if (first < 0) {
+      // node stays NODE_EXPANDING, and is a leaf from now on
+      return false;
+    }
+    int num_children = 0;
+    for (int i = 0; i < candidates.GetSize(); i++) {
+      Board::UndoToken token = board.MakeMove(candidates[i]);
+      if (token.is_valid) {
+        InitializeNode(nodes_[first + num_children], candidates[i], player,
+                       board.GetWinner(player));
+        num_children++;
+      }
+      board.UnmakeMove(token);
+    }
+    node.first_child = first;
+    node.num_children = num_children;
+    node.state.store(NODE_EXPANDED, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * Select a child of node by UCT, counting virtual losses as visits
+   */
+  Node *SelectChild(Node &node) {
+    int parent_visits = node.visits.load(std::memory_order_relaxed) +
+        node.virtual_loss.load(std::memory_order_relaxed);
+    double log_visits = log((double)parent_visits + 1);
+    Node *best = NULL;
+    double best_uct = -1;
+    for (int i = 0; i < node.num_children; i++) {
+      Node &child = nodes_[node.first_child + i];
+      int visits = child.visits.load(std::memory_order_relaxed) +
+          child.virtual_loss.load(std::memory_order_relaxed);
+      if (visits == 0) return &child;
+      double mean = child.score.load(std::memory_order_relaxed) /
+          (2.0 * visits);
+      double uct = mean + UCT_C * sqrt(log_visits / visits);
+      if (uct > best_uct) {
+        best_uct = uct;
+        best = &child;
+      }
+    }
+    return best;
+  }
+
+  /**
+   * One selection, expansion, playout and backup from the root.
+   * board is back at the root position on return.
+   */
+  void RunIteration(Board &board, const int player,
+                    Playout &playout, std::vector<Node *> &path) {
+    const Board::UndoToken token = board.GetUndoToken();
+    Node *node = &nodes_[0];
+    int turn = player;  // player to move at node
+    int winner = 0;
+    path.clear();
+    path.push_back(node);
+    node->virtual_loss.fetch_add(VIRTUAL_LOSS, std::memory_order_relaxed);
+    while (true) {
+      if (node->winner) {
+        winner = node->winner;
+        break;
+      }
+      if (node->state.load(std::memory_order_acquire) != NODE_EXPANDED) {
+        // expand a leaf on its second visit, and the root at once
+        if (node == path[0] || node->visits.load(std::memory_order_relaxed)) {
+          Expand(*node, board, turn);
+        }
+        if (node->state.load(std::memory_order_acquire) != NODE_EXPANDED) {
+          winner = playout.Run(board, turn);
+          break;
+        }
+      }
+      if (node->num_children == 0) {
+        // every move of turn breaks the rules
+        winner = GetOpponent(turn);
+        break;
+      }
+      node = SelectChild(*node);
+      node->virtual_loss.fetch_add(VIRTUAL_LOSS, std::memory_order_relaxed);
+      path.push_back(node);
+      board.MakeMove(node->move);
+      turn = GetOpponent(turn);
+    }
+    board.UnmakeMove(token);
+    for (size_t i = 0; i < path.size(); i++) {
+      Node &n = *path[i];
+      int score = (winner == 0) ? SCORE_DRAW :
+          (winner == n.mover) ? SCORE_WIN : SCORE_LOSS;
+      n.score.fetch_add(score, std::memory_order_relaxed);
+      n.visits.fetch_add(1, std::memory_order_relaxed);
+      n.virtual_loss.fetch_sub(VIRTUAL_LOSS, std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * Run iterations on a private copy of board until the deadline.
+   * Thread i plays with the i-th jump of the random stream of seed.
+   */
+  void Worker(const Board &root_board, const int player,
+              const uint64_t seed, const int thread_id) {
+    Board *board = new Board(root_board);
+    Playout playout(seed);
+    for (int i = 0; i < thread_id; i++) {
+      playout.GetRandom().Jump();
+    }
+    std::vector<Node *> path;
+    path.reserve(Playout::MAX_MOVES);
+    while (GetMonotonicTimeMs() < deadline_ &&
+           !(stop_ && stop_->load(std::memory_order_relaxed))) {
+      RunIteration(*board, player, playout, path);
+      num_playouts_.fetch_add(1, std::memory_order_relaxed);
+    }
+    delete board;
+  }
+
+
+ public:
+
+  //----------------------------------------------------------------------------
+  // Methods
+  //----------------------------------------------------------------------------
+
+  /**
+   * Constractor
+   * capacity: maximum number of tree nodes
+   */
+  explicit MonteCarloTreeSearch(const int capacity) :
+      nodes_(new Node[capacity]),
+      capacity_(capacity),
+      num_nodes_(0),
+      num_playouts_(0),
+      deadline_(0),
+      stop_(NULL),
+      stats_(NULL) {}
+
+  ~MonteCarloTreeSearch() {
+    delete [] nodes_;
+  }
+
+  /**
+   * Report every search to stats, NULL for none
+   */
+  void SetStatsFile(FILE *stats) {
+    stats_ = stats;
+  }
+
+  /**
+   * Search board for player to move on num_threads threads for time_ms,
+   * or until stop is set.
+   * Return the most visited move, or false if player has no legal move.
+   */
+  bool Search(const Board &board, const int player, const double time_ms,
+              const int num_threads, const uint64_t seed,
+              MoveList::Move &best_move,
+              const std::atomic<bool> *stop = NULL) {
+    stop_ = stop;
+    num_nodes_.store(1);
+    num_playouts_.store(0);
+    InitializeNode(nodes_[0], 0, GetOpponent(player), 0);
+    const double start = GetMonotonicTimeMs();
+    deadline_ = start + time_ms;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_threads; i++) {
+      threads.push_back(std::thread(&MonteCarloTreeSearch::Worker, this,
+                                    std::cref(board), player, seed, i));
+    }
+    for (int i = 0; i < num_threads; i++) {
+      threads[i].join();
+    }
+    double elapsed = GetMonotonicTimeMs() - start;
+
+    const Node &root = nodes_[0];
+    const Node *best = NULL;
+    if (root.state.load() == NODE_EXPANDED) {
+      for (int i = 0; i < root.num_children; i++) {
+        const Node &child = nodes_[root.first_child + i];
+        if (!best || child.visits.load() > best->visits.load()) best = &child;
+      }
+    }
+    long long num_playouts = num_playouts_.load();
+    if (stats_) {
+      fprintf(stats_, "MCTS: %lld playouts, %.0f playouts/s, %d nodes, "
+              "%d threads", num_playouts,
+              (elapsed > 0) ? num_playouts * 1000.0 / elapsed : 0.0,
+              (num_nodes_.load() < capacity_) ? num_nodes_.load() : capacity_,
+              num_threads);
+      if (best) {
+        fprintf(stats_, ", win rate %.3f", best->visits ?
+                best->score.load() / (2.0 * best->visits) : 0.0);
+      }
+      fprintf(stats_, "\n");
+    }
+    if (!best) return false;
+    best_move = best->move;
+    return true;
+  }
+};
+
+
+#endif  // end MCTS_HPP_
@@ -6,30 +6,92 @@ std::ostream& operator<<(std::ostream& stream, const move& m){
   return stream;
 }
 
+move::move() : x(0), y(0), tile(' ') {}
+
 move::move(const std::string m){
-  int step=0;
+  parse(m.data(), m.length());
+}
+
+move::move(const char* str, const int length){
+  parse(str, length);
+}
+
+// Parse one move such as "@0/" or "AB12\" from str[0..length).
+// Columns are bijective base 26 (A=1, Z=26, AA=27), '@' is column 0.
+// On a malformed move, x=y=0 and tile=' ' and false is returned.
+bool move::parse(const char* str, const int length){
   int pos=0;
 
   x=0;
   y=0;
-  
-  while(pos < m.length()){
-    char mm = m[pos];
-    switch(step){
-    case 0:
-      if(mm=='@'){ x=0; break; }
-      if('A'<=mm && mm<='Z'){ x*=26; x+= mm-'A'+1; break; }
-      y = mm-'0';
-      step = 1;
-      break;
-    case 1:
-      if('0'<=mm && mm<='9'){ y*=10; y+= mm-'0'; break; }
-      tile = mm;
-      step = 2;
-      break;
-    case 2:
-      break;
+  tile=' ';
+
+  if(pos < length && str[pos]=='@'){
+    pos++;
+  } else {
+    while(pos < length && 'A'<=str[pos] && str[pos]<='Z'){
+      x = x*26 + str[pos]-'A'+1;
+      if(x > MAX_COORD) break;
+      pos++;
     }
+  }
+  int col_end = pos;
+  while(pos < length && '0'<=str[pos] && str[pos]<='9'){
+    y = y*10 + str[pos]-'0';
+    if(y > MAX_COORD) break;
     pos++;
   }
+  if(col_end==0 || pos==col_end || pos+1!=length ||
+     (str[pos]!='+' && str[pos]!='/' && str[pos]!='\\')){
+    x=0;
+    y=0;
+    return false;
+  }
+  tile = str[pos];
+  return true;
+}
+
+// Write the move and a NUL into buf[0..size).
+// Return the length of the move, or 0 if it does not fit.
+int move::format(char* buf, const int size) const {
+  char col[4], row[4];
+  int cols=0, rows=0;
+
+  if(x<0 || x>MAX_COORD || y<0 || y>MAX_COORD) return 0;
+  if(x==0) col[cols++]='@';
+  for(int c=x; c>0; c=(c-1)/26) col[cols++] = 'A'+(c-1)%26;
+  int r=y;
+  do { row[rows++] = '0'+r%10; r/=10; } while(r>0);
+
+  int length = cols+rows+1;
+  if(length+1 > size) return 0;
+  int pos=0;
+  while(cols>0) buf[pos++] = col[--cols];
+  while(rows>0) buf[pos++] = row[--rows];
+  buf[pos++] = tile;
+  buf[pos] = '\0';
+  return length;
+}
+
+// Parse the moves of one line, separated by spaces or tabs, into
+// moves[0..max_moves). The line ends at length or at a newline.
+// Return the number of moves, or -1 if a word is not a move or there
+// are more than max_moves.
+int move::parse_line(const char* str, const int length,
+                     move* moves, const int max_moves){
+  int num=0;
+  int pos=0;
+
+  while(true){
+    while(pos < length &&
+          (str[pos]==' ' || str[pos]=='\t' || str[pos]=='\r')) pos++;
+    if(pos >= length || str[pos]=='\n') return num;
+    int begin=pos;
+    while(pos < length && str[pos]!=' ' && str[pos]!='\t' &&
+          str[pos]!='\r' && str[pos]!='\n') pos++;
+    if(num >= max_moves || !moves[num].parse(str+begin, pos-begin)){
+      return -1;
+    }
+    num++;
+  }
 }
@@ -0,0 +1,99 @@
+#ifndef MOVE_LIST_HPP_
+#define MOVE_LIST_HPP_
+
+
+#include <assert.h>
+#include <stdint.h>
+
+
+/**
+ * Fixed-capacity list of packed moves, to be kept on the stack.
+ * A move is 16 bits, the absolute cell y * BOARD_MAX + x in bits [15:2]
+ * and the shape id (0: '+', 1: '/', 2: '\') in bits [1:0]. Moves are
+ * converted to the notation only at the protocol boundary.
+ */
+class MoveList {
+ public:
+
+  //----------------------------------------------------------------------------
+  // Typedefs and Constants
+  //----------------------------------------------------------------------------
+
+  typedef uint16_t Move;
+
+  enum Restriction {
+    MAX_MOVES  = 2048,  // 3 shapes of 682 frontier cells, see Push
+    SHAPE_BITS = 2,
+    SHAPE_MASK = (1 << SHAPE_BITS) - 1,
+  };
+
+
+ private:
+
+  //----------------------------------------------------------------------------
+  // Members
+  //----------------------------------------------------------------------------
+
+  Move moves_[MAX_MOVES];
+  int size_;
+
+
+ public:
+
+  //----------------------------------------------------------------------------
+  // Methods
+  //----------------------------------------------------------------------------
+
+  /**
+   * Constractor
+   */
+  MoveList() : size_(0) {}
+
+  static inline Move Pack(const int cell, const int shape_id) {
+    return (Move)((cell << SHAPE_BITS) | shape_id);
+  }
+
+  static inline int GetCell(const Move m) {
+    return m >> SHAPE_BITS;
+  }
+
+  static inline int GetShapeId(const Move m) {
+    return m & SHAPE_MASK;
+  }
+
+  static inline char GetShape(const Move m) {
+    return (GetShapeId(m) == 0) ? '+' : (GetShapeId(m) == 1) ? '/' : '\\';
+  }
+
+  inline void Clear() {
+    size_ = 0;
+  }
+
+  /**
+   * Append a move. MAX_MOVES is not a proven bound, a snake of tiles on
+   * the 100x100 board can have a longer frontier than any real game, so
+   * running out of room is asserted rather than a legal move dropped
+   * silently. Without assertions the move is still dropped.
+   */
+  inline void Push(const Move m) {
+    assert(size_ < MAX_MOVES);
+    if (size_ < MAX_MOVES) moves_[size_++] = m;
+  }
+
+  inline int GetSize() const {
+    return size_;
+  }
+
+  inline Move operator[](const int i) const {
+    return moves_[i];
+  }
+
+  inline void Swap(const int i, const int j) {
+    Move tmp = moves_[i];
+    moves_[i] = moves_[j];
+    moves_[j] = tmp;
+  }
+};
+
+
+#endif  // end MOVE_LIST_HPP_
@@ -0,0 +1,112 @@
+/*
+   perft: move generation counter and benchmark
+
+   Usage:
+     perft [-t threads] [-n moves] [-d] record depth
+
+     Plays the moves of a game record (e.g. tests/longest-60.trx) and
+     counts the positions 1 to depth plies from the last position.
+     -t  count on threads threads (default 1)
+     -n  play only the first moves of the record
+     -d  print the count under each distinct first move
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <string>
+#include <vector>
+
+#include "trax.h"
+#include "board.hpp"
+#include "perft.hpp"
+#include "timer.hpp"
+#include "trx_record.hpp"
+
+
+/**
+ * Play up to max_moves moves of the record in filename on board.
+ * Return the number of moves, or -1 on an illegal move.
+ */
+static int LoadRecord(const char *filename, const int max_moves,
+                      Board &board) {
+  std::vector<move> moves;
+  std::string metadata;
+  if (!TrxRecord::Read(filename, moves, metadata)) {
+    fprintf(stderr, "perft: cannot read %s\n", filename);
+    return -1;
+  }
+  int num_moves = 0;
+  for (; num_moves < (int)moves.size() && num_moves < max_moves;
+       num_moves++) {
+    // the same check as trxdb, the first move at (0, 0) of the empty board
+    const move &m = moves[num_moves];
+    const int x = m.x + board.left, y = m.y + board.top;
+    bool is_valid = (num_moves == 0) ? (m.x == 0 && m.y == 0) :
+        (board.IsInside(m) && board.IsEmpty(x, y) &&
+         !board.IsIsolated(x, y) && board.IsValidMove(m));
+    if (!is_valid || !board.SetMove(m)) {
+      char buf[move::MAX_LENGTH];
+      moves[num_moves].format(buf, sizeof(buf));
+      fprintf(stderr, "perft: illegal move %d: %s\n", num_moves + 1, buf);
+      return -1;
+    }
+  }
+  return num_moves;
+}
+
+static void Usage() {
+  fprintf(stderr, "usage: perft [-t threads] [-n moves] [-d] record depth\n");
+  exit(1);
+}
+
+
+int main(int argc, char *argv[]) {
+  int num_threads = 1;
+  int max_moves = INT_MAX;
+  bool divide = false;
+  int i = 1;
+  for (; i < argc && argv[i][0] == '-'; i++) {
+    if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+      num_threads = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+      max_moves = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-d") == 0) {
+      divide = true;
+    } else {
+      Usage();
+    }
+  }
+  if (argc - i != 2 || num_threads < 1) Usage();
+  const char *filename = argv[i];
+  const int depth = atoi(argv[i + 1]);
+
+  Board *board = new Board();
+  int num_moves = LoadRecord(filename, max_moves, *board);
+  if (num_moves < 0) return 1;
+  printf("%s: %d moves\n", filename, num_moves);
+  if (board->GetWinFlags()) {
+    printf("game is over\n");
+  }
+
+  for (int d = 1; d <= depth; d++) {
+    std::vector<Perft::DivideEntry> entries;
+    double start = GetMonotonicTimeMs();
+    uint64_t count = Perft::Divide(*board, d, num_threads, entries);
+    double elapsed = GetMonotonicTimeMs() - start;
+    printf("perft %d: %llu positions, %.1f ms, %.0f positions/s\n", d,
+           (unsigned long long)count, elapsed,
+           (elapsed > 0) ? count * 1000.0 / elapsed : 0.0);
+    if (divide && d == depth) {
+      for (size_t j = 0; j < entries.size(); j++) {
+        const Perft::DivideEntry &e = entries[j];
+        char buf[move::MAX_LENGTH];
+        board->ToMove(e.move).format(buf, sizeof(buf));
+        printf("  %s %llu\n", buf, (unsigned long long)e.count);
+      }
+    }
+  }
+  delete board;
+  return 0;
+}
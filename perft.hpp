@@ -0,0 +1,152 @@
+#ifndef PERFT_HPP_
+#define PERFT_HPP_
+
+
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "board.hpp"
+#include "move_list.hpp"
+
+
+/**
+ * Move generation counter.
+ * perft(depth) counts the positions at depth plies from a board. Moves
+ * are made with their forced plays, moves whose forced plays break the
+ * rules are not counted, and moves of one node that reach the same
+ * position count once. A won position has no moves.
+ */
+class Perft {
+ public:
+
+  //----------------------------------------------------------------------------
+  // Typedefs and Constants
+  //----------------------------------------------------------------------------
+
+  /**
+   * Count of positions under one distinct root move
+   */
+  struct DivideEntry {
+    MoveList::Move move;
+    uint64_t count;
+  };
+
+
+ private:
+
+  //----------------------------------------------------------------------------
+  // Methods
+  //----------------------------------------------------------------------------
+
+  /**
+   * Pick up moves of board reaching distinct legal positions, the first
+   * move for each position
+   */
+  static void GatherDistinctMoves(Board &board,
+                                  std::vector<DivideEntry> &moves) {
+    MoveList all_moves;
+    std::vector<uint64_t> hashes;
+    board.GatherMoves(all_moves);
+    for (int i = 0; i < all_moves.GetSize(); i++) {
+      Board::UndoToken token = board.MakeMove(all_moves[i]);
+      uint64_t hash = board.GetHash();
+      if (token.is_valid &&
+          std::find(hashes.begin(), hashes.end(), hash) == hashes.end()) {
+        DivideEntry entry;
+        entry.move = all_moves[i];
+        entry.count = 0;
+        hashes.push_back(hash);
+        moves.push_back(entry);
+      }
+      board.UnmakeMove(token);
+    }
+  }
+
+  /**
+   * Count positions under every root move taken from next
+   */
+  static void Worker(const Board &root_board, const int depth,
+                     std::vector<DivideEntry> &moves,
+                     std::atomic<int> &next) {
+    Board *board = new Board(root_board);
+    for (int i = next++; i < (int)moves.size(); i = next++) {
+      DivideEntry &m = moves[i];
+      Board::UndoToken token = board->MakeMove(m.move);
+      m.count = board->GetWinFlags() ? 0 : Count(*board, depth - 1);
+      board->UnmakeMove(token);
+    }
+    delete board;
+  }
+
+
+ public:
+
+  //----------------------------------------------------------------------------
+  // Methods
+  //----------------------------------------------------------------------------
+
+  /**
+   * Count positions depth plies from board
+   */
+  static uint64_t Count(Board &board, const int depth) {
+    if (depth == 0) return 1;
+    MoveList moves;
+    std::vector<uint64_t> hashes;
+    uint64_t count = 0;
+    board.GatherMoves(moves);
+    for (int i = 0; i < moves.GetSize(); i++) {
+      Board::UndoToken token = board.MakeMove(moves[i]);
+      uint64_t hash = board.GetHash();
+      if (token.is_valid &&
+          std::find(hashes.begin(), hashes.end(), hash) == hashes.end()) {
+        hashes.push_back(hash);
+        if (depth == 1) {
+          count++;
+        } else if (!board.GetWinFlags()) {
+          count += Count(board, depth - 1);
+        }
+      }
+      board.UnmakeMove(token);
+    }
+    return count;
+  }
+
+  /**
+   * Count positions depth plies from board on num_threads threads, and
+   * the count under each distinct root move into divide
+   */
+  static uint64_t Divide(const Board &board, const int depth,
+                         const int num_threads,
+                         std::vector<DivideEntry> &divide) {
+    divide.clear();
+    if (depth == 0) return 1;
+    Board *root_board = new Board(board);
+    if (!root_board->GetWinFlags()) {
+      GatherDistinctMoves(*root_board, divide);
+    }
+    delete root_board;
+    if (depth == 1) {
+      for (size_t i = 0; i < divide.size(); i++) divide[i].count = 1;
+      return divide.size();
+    }
+    std::atomic<int> next(0);
+    std::vector<std::thread> threads;
+    for (int i = 1; i < num_threads; i++) {
+      threads.push_back(std::thread(&Perft::Worker, std::cref(board), depth,
+                                    std::ref(divide), std::ref(next)));
+    }
+    Worker(board, depth, divide, next);
+    for (size_t i = 0; i < threads.size(); i++) {
+      threads[i].join();
+    }
+    uint64_t count = 0;
+    for (size_t i = 0; i < divide.size(); i++) count += divide[i].count;
+    return count;
+  }
+};
+
+
+#endif  // end PERFT_HPP_
@@ -0,0 +1,110 @@
+#ifndef PLAYOUT_HPP_
+#define PLAYOUT_HPP_
+
+
+#include "board.hpp"
+#include "xoshiro.hpp"
+
+
+/**
+ * Random playout on a scratch Board.
+ * A playout allocates nothing. It picks a frontier cell and one of its
+ * legal shapes, and the caller takes the whole playout back with one
+ * UnmakeMove.
+ */
+class Playout {
+ public:
+
+  //----------------------------------------------------------------------------
+  // Typedefs and Constants
+  //----------------------------------------------------------------------------
+
+  enum Restriction {
+    TILE_PATTERNS = 3,
+    MAX_MOVES = 256,  // a longer playout is a draw
+  };
+
+
+ private:
+
+  //----------------------------------------------------------------------------
+  // Members
+  //----------------------------------------------------------------------------
+
+  Xoshiro256 random_;
+  long long num_moves_;  // moves played by all playouts
+
+
+  //----------------------------------------------------------------------------
+  // Methods
+  //----------------------------------------------------------------------------
+
+  static inline char GetTileShape(const int shape_id) {
+    return (shape_id == 0) ? '+' : (shape_id == 1) ? '/' : '\\';
+  }
+
+  /**
+   * Pick one shape of a legal-shape mask at random
+   */
+  inline int GetRandomShape(const int valid_shapes) {
+    // shape ids of the set bits of each mask
+    static const char SHAPES[8][TILE_PATTERNS] = {
+      {0, 0, 0}, {0, 0, 0}, {1, 1, 1}, {0, 1, 1},
+      {2, 2, 2}, {0, 2, 2}, {1, 2, 2}, {0, 1, 2},
+    };
+    static const char NUM_SHAPES[8] = {0, 1, 1, 2, 1, 2, 2, 3};
+    return SHAPES[valid_shapes][random_.GetRange(NUM_SHAPES[valid_shapes])];
+  }
+
+
+ public:
+
+  //----------------------------------------------------------------------------
+  // Methods
+  //----------------------------------------------------------------------------
+
+  /**
+   * Constractor
+   */
+  explicit Playout(const uint64_t seed = 0) :
+      random_(seed),
+      num_moves_(0) {}
+
+  Xoshiro256 &GetRandom() {
+    return random_;
+  }
+
+  long long GetNumMoves() {
+    return num_moves_;
+  }
+
+  /**
+   * Play random moves of player and the opponent on board until someone
+   * wins. A move whose forced plays break the rules is taken back and
+   * another one is tried.
+   * Return the winner, or 0 for a draw after max_moves tries.
+   */
+  int Run(Board &board, int player, const int max_moves = MAX_MOVES) {
+    for (int i = 0; i < max_moves; i++) {
+      int num_frontier = board.GetNumFrontier();
+      if (num_frontier == 0) return 0;
+      int x, y, valid_shapes;
+      board.GetFrontier(random_.GetRange(num_frontier), x, y, valid_shapes);
+      if (valid_shapes == 0) continue;
+      const char shape = GetTileShape(GetRandomShape(valid_shapes));
+      Board::UndoToken token = board.MakeMove(x, y, shape);
+      if (!token.is_valid) {
+        board.UnmakeMove(token);
+        continue;
+      }
+      num_moves_++;
+      int winner = board.GetWinner(player);
+      if (winner) return winner;
+      player = (player == 1) ? 2 : 1;
+    }
+    return 0;
+  }
+};
+
+
+#endif  // end PLAYOUT_HPP_
@@ -0,0 +1,422 @@
+#ifndef RULES_HPP_
+#define RULES_HPP_
+
+
+/**
+ * Trax placement rules shared by the referee and the solver boards.
+ * A board derives from Rules<Storage> and provides either
+ *   GetTileField(x, y)    TilePattern of (x, y), TILE_SPACE if empty
+ * or a faster GetAroundIndex(x, y) of its own. Every rule of a cell is a
+ * lookup in tables generated at compile time from its around colors.
+ */
+template <class Storage>
+class Rules {
+ public:
+
+  //----------------------------------------------------------------------------
+  // Typedefs and Constants
+  //----------------------------------------------------------------------------
+
+  enum ColorPattern {
+    COL_CLEAR = 0,
+    COL_WHITE = 1,
+    COL_RED   = 2,
+  };
+
+  /**
+   * N: North, E: East, S: South, W: West
+   */
+  enum DirectionPattern {
+    DIR_N = 0,
+    DIR_E = 1,
+    DIR_S = 2,
+    DIR_W = 3,
+  };
+
+  /**
+   * The bit-order is (W,S,E,N), N is LSB.
+   * If the bit is one, the direction's color is red.
+   */
+  enum TilePattern {
+    TILE_SPACE  = 0x0,  // ' ' (0000)
+    TILE_RED_NS = 0x5,  // '+' (0101)
+    TILE_RED_EW = 0xa,  // '+' (1010)
+    TILE_RED_WN = 0x9,  // '/' (1001)
+    TILE_RED_ES = 0x6,  // '/' (0110)
+    TILE_RED_SW = 0xc,  // '\' (1100)
+    TILE_RED_NE = 0x3,  // '\' (0011)
+    TILE_MASK   = 0xf,
+  };
+
+  /**
+   * Index of shapes in a legal-shape mask
+   */
+  enum ShapeIndex {
+    SHAPE_PLUS      = 0,  // '+'
+    SHAPE_SLASH     = 1,  // '/'
+    SHAPE_BACKSLASH = 2,  // '\'
+    SHAPE_NUM       = 3,
+  };
+
+  /**
+   * Rules of an empty cell for one tuple of around (N, E, S, W) colors.
+   * The tuple is packed as col_n + 3 * col_e + 9 * col_s + 27 * col_w.
+   */
+  enum AroundIndex {
+    AROUND_NUM = 3 * 3 * 3 * 3,
+  };
+
+  struct RuleEntry {
+    char valid_shapes;      // legal-shape mask
+    char tile[SHAPE_NUM];   // TilePattern placed for each shape
+    char forced_shape;      // '+', '/', '\\' or ' ' if the cell is not forced
+    char forced_tile;       // TilePattern of forced_shape
+  };
+
+  struct RuleTable {
+    RuleEntry entries[AROUND_NUM];
+  };
+
+  /**
+   * Properties of a TilePattern
+   */
+  struct TileEntry {
+    char shape;             // '+', '/', '\\' or ' '
+    char color;             // east color
+    char flipped_h;         // mirror image in left and right
+    char flipped_v;         // mirror image in top and bottom
+  };
+
+  struct TileTable {
+    TileEntry entries[TILE_MASK + 1];
+  };
+
+  /**
+   * Compile-time list of table indices
+   */
+  template <int... I> struct IndexPack {};
+  template <int N, int... I>
+  struct MakeIndexPack : MakeIndexPack<N - 1, N - 1, I...> {};
+  template <int... I>
+  struct MakeIndexPack<0, I...> {
+    typedef IndexPack<I...> Type;
+  };
+
+
+  //----------------------------------------------------------------------------
+  // Methods
+  //----------------------------------------------------------------------------
+
+  /**
+   * Offset of the neighbor at direction d
+   */
+  static inline int GetDX(const int d) {
+    return (d == DIR_E) ? 1 : (d == DIR_W) ? -1 : 0;
+  }
+  static inline int GetDY(const int d) {
+    return (d == DIR_S) ? 1 : (d == DIR_N) ? -1 : 0;
+  }
+  static inline int GetOppositeDir(const int d) {
+    return (d + 2) % 4;
+  }
+
+  /**
+   * Get the other end of the path that enters a tile from d
+   */
+  static inline int GetPathExit(const int tile_field, const int d) {
+    int color = (tile_field >> d) & 0x1;
+    for (int e = DIR_N; e <= DIR_W; e++) {
+      if (e != d && ((tile_field >> e) & 0x1) == color) return e;
+    }
+    return d;
+  }
+
+  /**
+   * Get opposite color of argument color
+   */
+  static inline int GetOppositeColor(const int color) {
+    return (color == COL_WHITE) ? COL_RED :
+        (color == COL_RED) ? COL_WHITE : COL_CLEAR;
+  }
+
+  /**
+   * Get shape index of '+', '/' or '\\'
+   */
+  static constexpr int GetShapeIndex(const char shape) {
+    return (shape == '+') ? SHAPE_PLUS :
+        (shape == '/') ? SHAPE_SLASH : SHAPE_BACKSLASH;
+  }
+
+  //----------------------------------------------------------------------------
+  // Rule tables, generated at compile time
+  //----------------------------------------------------------------------------
+
+  static constexpr int GetAroundColor(const int index, const int d) {
+    return (d == DIR_N) ? index % 3 : GetAroundColor(index / 3, d - 1);
+  }
+
+  static constexpr int GetEdgeColor(const int tile_field, const int d) {
+    return ((tile_field >> d) & 0x1) ? COL_RED : COL_WHITE;
+  }
+
+  static constexpr bool IsFitEdge(const int index, const int tile_field,
+                                  const int d) {
+    return GetAroundColor(index, d) == COL_CLEAR ||
+        GetAroundColor(index, d) == GetEdgeColor(tile_field, d);
+  }
+
+  static constexpr bool IsFit(const int index, const int tile_field) {
+    return IsFitEdge(index, tile_field, DIR_N) &&
+        IsFitEdge(index, tile_field, DIR_E) &&
+        IsFitEdge(index, tile_field, DIR_S) &&
+        IsFitEdge(index, tile_field, DIR_W);
+  }
+
+  static constexpr bool IsPairConflict(const int index,
+                                       const int d0, const int d1) {
+    return GetAroundColor(index, d0) != COL_CLEAR &&
+        GetAroundColor(index, d1) != COL_CLEAR &&
+        GetAroundColor(index, d0) != GetAroundColor(index, d1);
+  }
+
+  static constexpr int CountAroundColor(const int index, const int color) {
+    return (GetAroundColor(index, DIR_N) == color) +
+        (GetAroundColor(index, DIR_E) == color) +
+        (GetAroundColor(index, DIR_S) == color) +
+        (GetAroundColor(index, DIR_W) == color);
+  }
+
+  /**
+   * TilePattern of shape whose east color is color
+   */
+  static constexpr char GetShapeTile(const int shape_index, const int color) {
+    return (shape_index == SHAPE_PLUS) ?
+        ((color == COL_WHITE) ? TILE_RED_NS : TILE_RED_EW) :
+        (shape_index == SHAPE_SLASH) ?
+        ((color == COL_WHITE) ? TILE_RED_WN : TILE_RED_ES) :
+        ((color == COL_WHITE) ? TILE_RED_SW : TILE_RED_NE);
+  }
+
+  /**
+   * Rules of one shape from the around colors, checked against a
+   * brute-force search by TestBoard::TestRuleTable
+   */
+  static constexpr bool IsLineColorConnected(const int index,
+                                             const int shape_index) {
+    return IsFit(index, GetShapeTile(shape_index, COL_WHITE)) ||
+        IsFit(index, GetShapeTile(shape_index, COL_RED));
+  }
+
+  static constexpr bool IsConsistentPlacement(const int index,
+                                              const int shape_index) {
+    return (shape_index == SHAPE_PLUS) ?
+        !IsPairConflict(index, DIR_W, DIR_E) &&
+        !IsPairConflict(index, DIR_N, DIR_S) :
+        (shape_index == SHAPE_SLASH) ?
+        !IsPairConflict(index, DIR_W, DIR_N) &&
+        !IsPairConflict(index, DIR_S, DIR_E) :
+        !IsPairConflict(index, DIR_W, DIR_S) &&
+        !IsPairConflict(index, DIR_N, DIR_E);
+  }
+
+  static constexpr bool IsProhibited3(const int index) {
+    return CountAroundColor(index, COL_WHITE) >= 3 ||
+        CountAroundColor(index, COL_RED) >= 3;
+  }
+
+  static constexpr bool IsValidShape(const int index, const int shape_index) {
+    return IsLineColorConnected(index, shape_index) &&
+        IsConsistentPlacement(index, shape_index) && !IsProhibited3(index);
+  }
+
+  /**
+   * East color of a tile of shape, white edges meet white and red meet red.
+   * An isolated tile, the first move, is red on the east as in the referee.
+   */
+  static constexpr int GetShapeColor(const int index, const int shape_index) {
+    return (index == 0) ? COL_RED :
+        (shape_index == SHAPE_PLUS) ?
+        ((GetAroundColor(index, DIR_W) == COL_WHITE ||
+          GetAroundColor(index, DIR_E) == COL_WHITE ||
+          GetAroundColor(index, DIR_N) == COL_RED ||
+          GetAroundColor(index, DIR_S) == COL_RED) ? COL_WHITE : COL_RED) :
+        (shape_index == SHAPE_SLASH) ?
+        ((GetAroundColor(index, DIR_W) == COL_WHITE ||
+          GetAroundColor(index, DIR_N) == COL_WHITE ||
+          GetAroundColor(index, DIR_S) == COL_RED ||
+          GetAroundColor(index, DIR_E) == COL_RED) ? COL_RED : COL_WHITE) :
+        ((GetAroundColor(index, DIR_W) == COL_WHITE ||
+          GetAroundColor(index, DIR_S) == COL_WHITE ||
+          GetAroundColor(index, DIR_N) == COL_RED ||
+          GetAroundColor(index, DIR_E) == COL_RED) ? COL_RED : COL_WHITE);
+  }
+
+  static constexpr bool IsSameAround(const int index,
+                                     const int d0, const int d1) {
+    return GetAroundColor(index, d0) != COL_CLEAR &&
+        GetAroundColor(index, d0) == GetAroundColor(index, d1);
+  }
+
+  /**
+   * Forced shape of an empty cell, or ' '.
+   * Two same colors on opposite sides force '+' over the corner shapes.
+   */
+  static constexpr char GetForcedShape(const int index) {
+    return ((IsSameAround(index, DIR_W, DIR_E) &&
+             !IsSameAround(index, DIR_E, DIR_S) &&
+             !IsSameAround(index, DIR_E, DIR_N)) ||
+            (IsSameAround(index, DIR_N, DIR_S) &&
+             !IsSameAround(index, DIR_S, DIR_W) &&
+             !IsSameAround(index, DIR_S, DIR_E))) ? '+' :
+        (IsSameAround(index, DIR_E, DIR_N) ||
+         IsSameAround(index, DIR_S, DIR_W)) ? '\\' :
+        (IsSameAround(index, DIR_W, DIR_N) ||
+         IsSameAround(index, DIR_S, DIR_E)) ? '/' : ' ';
+  }
+
+  static constexpr RuleEntry MakeRuleEntry(const int index) {
+    return RuleEntry{
+      (char)((IsValidShape(index, SHAPE_PLUS) ? (1 << SHAPE_PLUS) : 0) |
+             (IsValidShape(index, SHAPE_SLASH) ? (1 << SHAPE_SLASH) : 0) |
+             (IsValidShape(index, SHAPE_BACKSLASH) ?
+              (1 << SHAPE_BACKSLASH) : 0)),
+      {GetShapeTile(SHAPE_PLUS, GetShapeColor(index, SHAPE_PLUS)),
+       GetShapeTile(SHAPE_SLASH, GetShapeColor(index, SHAPE_SLASH)),
+       GetShapeTile(SHAPE_BACKSLASH, GetShapeColor(index, SHAPE_BACKSLASH))},
+      GetForcedShape(index),
+      (GetForcedShape(index) == ' ') ? (char)TILE_SPACE :
+      GetShapeTile(GetShapeIndex(GetForcedShape(index)),
+                   GetShapeColor(index, GetShapeIndex(GetForcedShape(index))))
+    };
+  }
+
+  template <int... I>
+  static constexpr RuleTable MakeRuleTable(IndexPack<I...>) {
+    return RuleTable{{MakeRuleEntry(I)...}};
+  }
+
+  static constexpr char GetFieldShape(const int tile_field) {
+    return (tile_field == TILE_RED_NS || tile_field == TILE_RED_EW) ? '+' :
+        (tile_field == TILE_RED_WN || tile_field == TILE_RED_ES) ? '/' :
+        (tile_field == TILE_RED_SW || tile_field == TILE_RED_NE) ? '\\' : ' ';
+  }
+
+  static constexpr TileEntry MakeTileEntry(const int tile_field) {
+    return TileEntry{
+      GetFieldShape(tile_field),
+      (char)((GetFieldShape(tile_field) == ' ') ? COL_CLEAR :
+             GetEdgeColor(tile_field, DIR_E)),
+      (char)((GetFieldShape(tile_field) == '+' ||
+              GetFieldShape(tile_field) == ' ') ? tile_field :
+             GetShapeTile(GetShapeIndex(GetFieldShape(tile_field)) ^ 0x3,
+                          GetEdgeColor(tile_field, DIR_W))),
+      (char)((GetFieldShape(tile_field) == '+' ||
+              GetFieldShape(tile_field) == ' ') ? tile_field :
+             GetShapeTile(GetShapeIndex(GetFieldShape(tile_field)) ^ 0x3,
+                          GetEdgeColor(tile_field, DIR_E)))
+    };
+  }
+
+  template <int... I>
+  static constexpr TileTable MakeTileTable(IndexPack<I...>) {
+    return TileTable{{MakeTileEntry(I)...}};
+  }
+
+  static inline const RuleEntry &GetRuleEntry(const int index) {
+    static constexpr RuleTable table =
+        MakeRuleTable(typename MakeIndexPack<AROUND_NUM>::Type());
+    return table.entries[index];
+  }
+
+  static inline const TileEntry &GetTileEntry(const char block) {
+    static constexpr TileTable table =
+        MakeTileTable(typename MakeIndexPack<TILE_MASK + 1>::Type());
+    return table.entries[block & TILE_MASK];
+  }
+
+  /**
+   * Get color of the edge of tile_field at direction d, COL_CLEAR if empty
+   */
+  static inline int GetFieldColor(const int tile_field, const int d) {
+    return (tile_field == TILE_SPACE) ? COL_CLEAR : GetEdgeColor(tile_field, d);
+  }
+
+  inline Storage &Self() {
+    return static_cast<Storage &>(*this);
+  }
+
+  /**
+   * Get packed around colors of (x, y), an index of the rule table
+   */
+  inline int GetAroundIndex(const int x, const int y) {
+    Storage &s = Self();
+    return GetFieldColor(s.GetTileField(x, y - 1), DIR_S) +
+        3 * GetFieldColor(s.GetTileField(x + 1, y), DIR_W) +
+        9 * GetFieldColor(s.GetTileField(x, y + 1), DIR_N) +
+        27 * GetFieldColor(s.GetTileField(x - 1, y), DIR_E);
+  }
+
+  /**
+   * Get (x, y)'s color
+   */
+  inline int GetColor(const int x, const int y, const char shape) {
+    const RuleEntry &rule = GetRuleEntry(Self().GetAroundIndex(x, y));
+    return GetTileEntry(rule.tile[GetShapeIndex(shape)]).color;
+  }
+
+  /**
+   * Get TilePattern of shape placed on (x, y)
+   */
+  inline char GetPlacedTile(const int x, const int y, const char shape) {
+    return GetRuleEntry(Self().GetAroundIndex(x, y))
+        .tile[GetShapeIndex(shape)];
+  }
+
+  /**
+   * Check whether (x, y) is consistent placement
+   */
+  inline bool IsConsistentPlacement(int x, int y, char shape) {
+    return IsConsistentPlacement(Self().GetAroundIndex(x, y),
+                                 GetShapeIndex(shape));
+  }
+
+  /**
+   * Check whether (x, y) is line color connected
+   */
+  inline bool IsLineColorConnected(const int x, const int y, const char shape) {
+    return IsLineColorConnected(Self().GetAroundIndex(x, y),
+                                GetShapeIndex(shape));
+  }
+
+  /**
+   * Check whether the tile placed on (x, y) meets every neighbor with the
+   * same color
+   */
+  inline bool IsTileConnected(const int x, const int y) {
+    return IsFit(Self().GetAroundIndex(x, y), Self().GetTileField(x, y));
+  }
+
+  /**
+   * Check whether (x, y) is prohibit pattern
+   */
+  inline bool IsProhibited3(const int x, const int y) {
+    return IsProhibited3(Self().GetAroundIndex(x, y));
+  }
+
+  /**
+   * Get legal-shape mask of (x, y), bit s is set if shape s is valid
+   */
+  inline int GetValidShapes(const int x, const int y) {
+    return GetRuleEntry(Self().GetAroundIndex(x, y)).valid_shapes;
+  }
+
+  /**
+   * Get forced shape of the empty cell (x, y), or ' '
+   */
+  inline char GetForcedShape(const int x, const int y) {
+    return GetRuleEntry(Self().GetAroundIndex(x, y)).forced_shape;
+  }
+};
+
+
+#endif  // end RULES_HPP_
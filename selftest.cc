@@ -0,0 +1,32 @@
+/*
+   Self-test of Board
+
+   Usage:
+     trax -T
+
+     Runs the checks of TestBoard that verify themselves: the frontier
+     and its valid shapes, MakeMove and UnmakeMove over random forced
+     chains, the hash under translation and mirroring, the rule tables
+     and the move notation. Each prints OK, and the first failure is
+     printed with "Test Error" and the exit status is 1.
+ */
+
+#include <stdio.h>
+
+#include "trax.h"
+#include "test_board.hpp"
+
+int selftest_main(int argc, char* argv[]){
+  if(argc > 0){
+    fprintf(stderr, "usage: trax -T\n");
+    return 1;
+  }
+  TestBoard* test_board = new TestBoard();
+  test_board->TestFrontier();
+  test_board->TestMakeUnmakeMove();
+  test_board->TestHash();
+  test_board->TestRuleTable();
+  test_board->TestNotation();
+  delete test_board;
+  return 0;
+}
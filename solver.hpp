@@ -4,6 +4,8 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
+#include <atomic>
 #include <iostream>
 #include <fstream>
 #include <string>
@@ -14,11 +16,31 @@
 #include "board.hpp"
 // #include "board_osana.hpp"
 #include "timer.hpp"
+#include "transposition_table.hpp"
+#include "mcts.hpp"
+#include "move_list.hpp"
+#include "threat_search.hpp"
+#include "xoshiro.hpp"
 
 #define FIRST_MOVE_0 "@0/"
 #define FIRST_MOVE_1 "@0+"
 
 class TraxSolver {
+ public:
+
+  //----------------------------------------------------------------------------
+  // Typedefs and Constants
+  //----------------------------------------------------------------------------
+
+  enum EngineMode {
+    ENGINE_RANDOM     = 0,
+    ENGINE_LOOP_ATACK = 1,
+    ENGINE_SEARCH     = 2,  // alpha-beta with transposition table
+    ENGINE_ITERATIVE  = 3,  // iterative deepening PVS until a deadline
+    ENGINE_MCTS       = 4,  // tree-parallel Monte Carlo tree search
+  };
+
+
  private:
 
   //----------------------------------------------------------------------------
@@ -31,16 +53,46 @@ class TraxSolver {
   static const int BOARD_MAX_HALF = BOARD_MAX / 2;
   static const int TILE_PATTERNS = 3;
 
+  // Search
+  static const int SCORE_INFINITE = 30000;
+  static const int SCORE_WIN = 20000;
+  static const int SCORE_WIN_MIN = SCORE_WIN - 1000;
+  static const int SEARCH_DEPTH = 2;
+  static const int MAX_DEPTH = 64;
+  static const int THINK_TIME_MS = 1000;
+  static const int CHECK_TIME_NODES = 1024;  // nodes between clock reads
+  static const int TT_SIZE_MB = 16;
+  static const int MCTS_NODES = 1 << 20;
+  static const int THREAT_DEPTH = 4;      // moves of the attacker
+  static const int THREAT_TIME_PERCENT = 20;  // of the think time
+  static const uint64_t SIDE_KEY = 0x9e3779b97f4a7c15ULL;  // red to move
 
   //----------------------------------------------------------------------------
   // Members
   //----------------------------------------------------------------------------
 
   int player_;
+  int engine_;
+  double think_time_ms_;
+  bool use_threat_search_;  // for a forced win before the engine thinks
+  int num_threads_;  // of MCTS, 0 for every core
   Board board_;
+  Xoshiro256 random_;
+
+  // Search
+  TranspositionTable *tt_;
+  MoveList::Move root_move_;
+  bool has_root_move_;
+  uint64_t nodes_;
+  double deadline_;  // ms of GetMonotonicTimeMs
+  bool stopped_;
+  std::atomic<bool> stop_;  // set by Stop() from another thread
+  MonteCarloTreeSearch *mcts_;  // created on first use
+  ThreatSearch threat_search_;
+  FILE *stats_;  // reports of thinking, NULL for none
 
   // Timers
-  Timer *think_time_;
+  ProfileTimer think_time_;
 
   
   //----------------------------------------------------------------------------
@@ -52,45 +104,28 @@ class TraxSolver {
   }
 
   /**
-   * Pick up all valid moves
+   * Pick a legal move at random, or an empty move (tile ' ') if there is
+   * none, as the fallback of the other engines
    */
-  void GatherValidMoves(std::vector<move> &valid_moves) {
-    for (int y = -BOARD_MAX_HALF; y < BOARD_MAX_HALF; y++) {
-      int yy = y + board_.top;      
-      if (yy <= 0) continue;
-      for (int x = -BOARD_MAX_HALF; x < BOARD_MAX_HALF; x++) {
-        int xx = x + board_.left;
-        if (xx <= 0) continue;
-        if (!board_.IsEmpty(xx, yy)) continue;
-        if (board_.IsIsolated(xx, yy)) continue;
-        for (int t = 0; t < TILE_PATTERNS; t++) {
-          char tile = GetTileShape(t);
-          if (!board_.IsValidMove(xx, yy, tile)) continue;
-          valid_moves.push_back(move(GetMoveString(x, y, tile)));
-        }
-      }
-    }
-    // printf("# valid moves: %ld\n", valid_moves.size());
-  }
-  
   move ThinkMoveRandom() {
-    std::vector<move> valid_moves;
-    GatherValidMoves(valid_moves);
-    int num_moves = valid_moves.size();
-    return valid_moves[rand() % num_moves];
+    MoveList valid_moves;
+    board_.GatherMoves(valid_moves);
+    int num_moves = valid_moves.GetSize();
+    if (num_moves == 0) return move();
+    return board_.ToMove(valid_moves[random_.GetRange(num_moves)]);
   }  
 
   /**
    * Find a move that checkmate or defence loop atack
    * If no such move, return FIRST_MOVE_0
    */
-  move LoopAtack(std::vector<move> &valid_moves) {
+  move LoopAtack(const MoveList &valid_moves) {
     int selected_x = 0, selected_y = 0;
     char selected_shape = '/';
     move selected_move("");
-    for (std::vector<move>::iterator itr = valid_moves.begin();
-         itr != valid_moves.end(); itr++) {
-      const move m = *itr;
+    for (int i = 0; i < valid_moves.GetSize(); i++) {
+      int x, y;
+      Board::UnpackMove(valid_moves[i], x, y);
       move temp_move0(""), temp_move1("");
       int temp_x, temp_y;
       char temp_shape;
@@ -98,10 +133,16 @@ class TraxSolver {
       // loop_atack_type = board_.SelectLoopAtackMove(
       //     player_, m.x , m.y, temp_x, temp_y, temp_shape);
       loop_atack_type = board_.SelectLoopAtackMove(
-          player_, m.x , m.y, temp_move0, temp_move1);
-      if (loop_atack_type == 0) {
-        continue;
-      } else if (loop_atack_type == 1) {  // if checkmate
+          player_, x - board_.left, y - board_.top, temp_move0, temp_move1);
+      if (loop_atack_type == 0) continue;
+      if (stats_) {
+        // the loop of the player is a checkmate, of the opponent a defence
+        bool is_white = (player_ == PLAYER_WHITE) == (loop_atack_type == 1);
+        fprintf(stats_, "-------- Detect %s loop at (%d, %d), %s!\n",
+                is_white ? "white" : "red", temp_move0.x, temp_move0.y,
+                (loop_atack_type == 1) ? "checkmate" : "defence");
+      }
+      if (loop_atack_type == 1) {  // if checkmate
         // return move(GetMoveString(temp_x, temp_y, temp_shape));
         selected_move = temp_move0;        
         return selected_move;
@@ -110,12 +151,12 @@ class TraxSolver {
           selected_move = temp_move0;
           continue;
         }
-        printf("loop defence skip 0\n");
+        if (stats_) fprintf(stats_, "loop defence skip 0\n");
         if (board_.IsValidMove(temp_move1)) {
           selected_move = temp_move1;
           continue;
         }
-        printf("loop defence candidate is error\n");
+        if (stats_) fprintf(stats_, "loop defence candidate is error\n");
         // selected_move = temp_move0;
         // selected_x = temp_x;
         // selected_y = temp_y;
@@ -127,19 +168,234 @@ class TraxSolver {
   }
   
   move ThinkMoveLoopAtack() {
-    std::vector<move> valid_moves;
-    GatherValidMoves(valid_moves);    
-    int num_moves = valid_moves.size();
+    MoveList valid_moves;
+    board_.GatherMoves(valid_moves);
+    int num_moves = valid_moves.GetSize();
     move loop_atack_move = LoopAtack(valid_moves);
     if (loop_atack_move.x != 0 || loop_atack_move.y != 0) {
       return loop_atack_move;
     }
-    return valid_moves[rand() % num_moves];
+    if (num_moves == 0) return move();
+    return board_.ToMove(valid_moves[random_.GetRange(num_moves)]);
   }  
   
+  /**
+   * Search key of board_ with player to move
+   */
+  inline uint64_t GetSearchKey(const int player) {
+    return board_.GetHash() ^ ((player == PLAYER_RED) ? SIDE_KEY : 0);
+  }
+
+  /**
+   * Pack a move relative to the bounding box for the transposition table
+   */
+  inline int EncodeMove(const MoveList::Move m) {
+    int x, y;
+    Board::UnpackMove(m, x, y);
+    return ((x - board_.left) << 9) | ((y - board_.top) << 2) |
+        MoveList::GetShapeId(m);
+  }
+
+  /**
+   * Win scores are stored as distance from the node, not from the root
+   */
+  static inline int ScoreToTT(const int score, const int ply) {
+    return (score >= SCORE_WIN_MIN) ? score + ply :
+        (score <= -SCORE_WIN_MIN) ? score - ply : score;
+  }
+
+  static inline int ScoreFromTT(const int score, const int ply) {
+    return (score >= SCORE_WIN_MIN) ? score - ply :
+        (score <= -SCORE_WIN_MIN) ? score + ply : score;
+  }
+
+  /**
+   * Static evaluation of board_ for player
+   */
+  int Evaluate(const int player) {
+    return board_.GetPathBalance(player);
+  }
+
+  /**
+   * Negamax alpha-beta search with principal variation search on board_
+   * for player to move. Every move is expanded with its forced plays.
+   * Return 0 and set stopped_ when the deadline passes or Stop() is called.
+   */
+  int Search(const int player, const int depth, const int ply,
+             int alpha, int beta) {
+    if (++nodes_ % CHECK_TIME_NODES == 0 &&
+        (GetMonotonicTimeMs() >= deadline_ ||
+         stop_.load(std::memory_order_relaxed))) {
+      stopped_ = true;
+    }
+    if (stopped_) return 0;
+    const int alpha_orig = alpha;
+    const uint64_t key = GetSearchKey(player);
+    int tt_move = TranspositionTable::MOVE_NONE;
+    TranspositionTable::Entry entry;
+    if (tt_->Probe(key, entry)) {
+      int score = ScoreFromTT(entry.score, ply);
+      tt_move = entry.move;
+      if (ply > 0 && entry.depth >= depth &&
+          (entry.bound == TranspositionTable::BOUND_EXACT ||
+           (entry.bound == TranspositionTable::BOUND_LOWER && score >= beta) ||
+           (entry.bound == TranspositionTable::BOUND_UPPER && score <= alpha))) {
+        return score;
+      }
+    }
+    if (depth == 0) return Evaluate(player);
+
+    MoveList moves;
+    board_.GatherMoves(moves);
+    int num_moves = moves.GetSize();
+    if (ply == 0) {
+      // break ties between equal scores at random
+      for (int i = num_moves - 1; i > 0; i--) {
+        moves.Swap(i, random_.GetRange(i + 1));
+      }
+    }
+    for (int i = 0; i < num_moves; i++) {
+      if (EncodeMove(moves[i]) != tt_move) continue;
+      moves.Swap(0, i);
+      break;
+    }
+
+    const int opponent = (player == PLAYER_WHITE) ? PLAYER_RED : PLAYER_WHITE;
+    int best_score = -SCORE_INFINITE;
+    int best_move = TranspositionTable::MOVE_NONE;
+    bool is_first = true;
+    for (int i = 0; i < num_moves; i++) {
+      const MoveList::Move m = moves[i];
+      const int code = EncodeMove(m);
+      Board::UndoToken token = board_.MakeMove(m);
+      if (!token.is_valid) {
+        board_.UnmakeMove(token);
+        continue;
+      }
+      int score;
+      int winner = board_.GetWinner(player);
+      if (winner == player) {
+        score = SCORE_WIN - ply - 1;
+      } else if (winner == opponent) {
+        score = -(SCORE_WIN - ply - 1);
+      } else if (is_first) {
+        score = -Search(opponent, depth - 1, ply + 1, -beta, -alpha);
+      } else {
+        // null window to prove the move is not better than alpha
+        score = -Search(opponent, depth - 1, ply + 1, -alpha - 1, -alpha);
+        if (score > alpha && score < beta) {
+          score = -Search(opponent, depth - 1, ply + 1, -beta, -alpha);
+        }
+      }
+      board_.UnmakeMove(token);
+      if (stopped_) return 0;
+      is_first = false;
+      if (score > best_score) {
+        best_score = score;
+        best_move = code;
+        if (ply == 0) {
+          root_move_ = m;
+          has_root_move_ = true;
+        }
+      }
+      if (score > alpha) alpha = score;
+      if (alpha >= beta) break;
+    }
+    if (best_move == TranspositionTable::MOVE_NONE) return 0;
+
+    int bound = (best_score <= alpha_orig) ? TranspositionTable::BOUND_UPPER :
+        (best_score >= beta) ? TranspositionTable::BOUND_LOWER :
+        TranspositionTable::BOUND_EXACT;
+    tt_->Store(key, depth, bound, ScoreToTT(best_score, ply), best_move);
+    return best_score;
+  }
+
+  /**
+   * Iterative deepening from depth 1 to max_depth until time_ms passes.
+   * The best move of the deepest completed iteration is returned.
+   */
+  move ThinkMoveIterative(const int max_depth, const double time_ms) {
+    tt_->NewSearch();
+    nodes_ = 0;
+    stopped_ = false;
+    const double start = GetMonotonicTimeMs();
+    deadline_ = start + time_ms;
+    MoveList::Move best_move = 0;
+    bool has_best_move = false;
+    int depth_reached = 0, best_score = 0;
+    for (int depth = 1; depth <= max_depth; depth++) {
+      has_root_move_ = false;
+      int score = Search(player_, depth, 0, -SCORE_INFINITE, SCORE_INFINITE);
+      if (stopped_) break;
+      if (has_root_move_) {
+        best_move = root_move_;
+        has_best_move = true;
+      }
+      depth_reached = depth;
+      best_score = score;
+      if (score >= SCORE_WIN_MIN || score <= -SCORE_WIN_MIN) break;
+    }
+    double elapsed = GetMonotonicTimeMs() - start;
+    if (stats_) {
+      fprintf(stats_, "Search: depth %d, score %d, nodes %llu, %.0f nps\n",
+              depth_reached, best_score, (unsigned long long)nodes_,
+              (elapsed > 0) ? nodes_ * 1000.0 / elapsed : 0.0);
+    }
+    if (!has_best_move) return ThinkMoveRandom();
+    return board_.ToMove(best_move);
+  }
+
+  /**
+   * Find a forced win by loop or line threats within time_ms
+   * Return false if no forced win is found
+   */
+  bool ThinkMoveThreat(const double time_ms, move &m) {
+    MoveList::Move win;
+    if (!threat_search_.Search(board_, player_, THREAT_DEPTH, time_ms, win,
+                               &stop_)) {
+      return false;
+    }
+    m = board_.ToMove(win);
+    return true;
+  }
+
+  move ThinkMoveMcts(const double time_ms) {
+    if (!mcts_) {
+      mcts_ = new MonteCarloTreeSearch(MCTS_NODES);
+      mcts_->SetStatsFile(stats_);
+    }
+    int num_threads = num_threads_;
+    if (num_threads < 1) num_threads = std::thread::hardware_concurrency();
+    if (num_threads < 1) num_threads = 1;
+    MoveList::Move best;
+    if (!mcts_->Search(board_, player_, time_ms, num_threads,
+                       random_.Next(), best, &stop_)) {
+      return ThinkMoveRandom();
+    }
+    return board_.ToMove(best);
+  }
+
+  /**
+   * Think a move by the engine, time_ms for ENGINE_ITERATIVE and ENGINE_MCTS
+   */
+  move ThinkMove(const double time_ms) {
+    switch (engine_) {
+      case ENGINE_RANDOM: return ThinkMoveRandom();
+      case ENGINE_SEARCH: return ThinkMoveSearch();
+      case ENGINE_ITERATIVE:
+        return ThinkMoveIterative(MAX_DEPTH, time_ms);
+      case ENGINE_MCTS: return ThinkMoveMcts(time_ms);
+      default: return ThinkMoveLoopAtack();
+    }
+  }
+
+  move ThinkMoveSearch() {
+    return ThinkMoveIterative(SEARCH_DEPTH, 1e30);
+  }
+
   void PrintProfile() {
-    printf("Time (ms)\tCalls\tAvg (ms)\tMin (ms) \tMax (ms)\tName\n");
-    think_time_->PrintTime();
+    printf("Ticks\tCalls\tAvg (ticks)\tMin (ticks)\tMax (ticks)\tName\n");
+    think_time_.PrintTime();
     board_.PrintProfile();
   }
   
@@ -150,47 +406,142 @@ class TraxSolver {
   // Methods
   //----------------------------------------------------------------------------
   
-  TraxSolver(int player) :
+  /**
+   * Constractor
+   * seed: seed of every random choice, the same seed replays a game
+   */
+  TraxSolver(int player, int engine = ENGINE_LOOP_ATACK,
+             uint64_t seed = time(0)) :
       player_(player),
-      think_time_ (new Timer("ThinkMove")) {
-    // srand(0);
-    srand(time(0));
+      engine_(engine),
+      think_time_ms_(THINK_TIME_MS),
+      use_threat_search_(engine == ENGINE_ITERATIVE || engine == ENGINE_MCTS),
+      num_threads_(0),
+      random_(seed + player),
+      tt_(new TranspositionTable(TT_SIZE_MB)),
+      has_root_move_(false),
+      nodes_(0),
+      deadline_(0),
+      stopped_(false),
+      stop_(false),
+      mcts_(NULL),
+      stats_(NULL),
+      think_time_("ThinkMove") {
     // TestBoard test_board;
     // test_board.TestGetColorX();
     // test_board.TestSetTile();
     // test_board.TestSetMove();
     // test_board.TestDetectLoop();
+    // test_board.TestFrontier();
+    // test_board.TestMakeUnmakeMove();
+    // test_board.TestHash();
+    // test_board.TestRuleTable();
+    // test_board.TestNotation();
     // exit(0);
   }
 
   ~TraxSolver() {
-    delete think_time_;
+    delete tt_;
+    delete mcts_;
   }
 
-  std::string GetMoveString(int x, int y, char tile) {
-    static const int ALPHABETS = 26;
-    // x string
-    std::string str_x = "";
-    if (x == 0) {
-      str_x = "@";
-    } else {
-      char digit;
-      char least_digit = x % ALPHABETS;
-      for (; x > ALPHABETS; x /= ALPHABETS) {
-        digit = 'A' + (x / ALPHABETS) - 1;
-        str_x.append(std::string(1, digit));
-      }
-      digit = 'A' + least_digit - 1;
-      str_x.append(std::string(1, digit));      
+  /**
+   * Get EngineMode named random, loop, search, iterative or mcts, or -1
+   */
+  static int GetEngineMode(const std::string &name) {
+    static const char *NAMES[] = {"random", "loop", "search", "iterative",
+                                  "mcts"};
+    for (int i = 0; i < (int)(sizeof(NAMES) / sizeof(NAMES[0])); i++) {
+      if (name == NAMES[i]) return i;
     }
-    // y and tile string
-    char buf[BUFSIZ];
-    sprintf(buf, "%d%c", y, tile);
-    return str_x.append(buf);
+    return -1;
   }
 
-  std::string GetMoveString(move m) {
-    return GetMoveString(m.x, m.y, m.tile);
+  /**
+   * Set time to think a move of ENGINE_ITERATIVE and ENGINE_MCTS
+   */
+  void SetThinkTime(const double time_ms) {
+    think_time_ms_ = time_ms;
+  }
+
+  /**
+   * Search a forced win by threats in a share of the think time before
+   * the engine thinks. It is used by ENGINE_ITERATIVE and ENGINE_MCTS
+   * unless turned off here, and by the other engines only when turned on.
+   */
+  void SetThreatSearch(const bool use_threat_search) {
+    use_threat_search_ = use_threat_search;
+  }
+
+  /**
+   * Stop thinking from another thread, Think returns the best move found
+   * so far. Call Stop(false) before thinking again.
+   */
+  void Stop(const bool stop = true) {
+    stop_.store(stop);
+  }
+
+  /**
+   * Report the thinking of every move to stats, such as stdout or stderr.
+   * Nothing is reported by default or when stats is NULL.
+   */
+  void SetStatsFile(FILE *stats) {
+    stats_ = stats;
+    threat_search_.SetStatsFile(stats);
+    if (mcts_) mcts_->SetStatsFile(stats);
+  }
+
+  /**
+   * Set number of threads of ENGINE_MCTS, 0 for every core
+   */
+  void SetNumThreads(const int num_threads) {
+    num_threads_ = num_threads;
+  }
+
+  std::string GetMoveString(int x, int y, char tile) {
+    move m;
+    m.x = x;
+    m.y = y;
+    m.tile = tile;
+    return GetMoveString(m);
+  }
+
+  std::string GetMoveString(const move &m) {
+    char buf[move::MAX_LENGTH];
+    return m.format(buf, sizeof(buf)) ? std::string(buf) : std::string();
+  }
+
+  /**
+   * Set a move of either player without thinking, such as an opening
+   */
+  void SetMove(const move m) {
+    board_.SetMove(m);
+  }
+
+  /**
+   * Think a move of player and set it
+   */
+  move Think() {
+    move my_move;
+    think_time_.Start();
+    const double start = GetMonotonicTimeMs();
+    // a forced win found by threats overrides the engine, which thinks in
+    // the rest of the time
+    if (!use_threat_search_ ||
+        !ThinkMoveThreat(think_time_ms_ * THREAT_TIME_PERCENT / 100,
+                         my_move)) {
+      my_move = ThinkMove(think_time_ms_ - (GetMonotonicTimeMs() - start));
+    }
+    think_time_.Stop();
+    board_.SetMove(my_move);
+    if (stats_) {
+      fprintf(stats_, "Set (X: %d, Y: %d, Tile: %c)\n",
+              my_move.x + board_.left, my_move.y + board_.top, my_move.tile);
+    }
+    // board_.PrintBorder();
+    // board_.PrintBoard();
+    // PrintProfile();
+    return my_move;
   }
 
   void MyTurn(int turn, const move opp_move, move &my_move) {
@@ -199,16 +550,7 @@ class TraxSolver {
       board_.SetMove(my_move);
     } else {
       board_.SetMove(opp_move);
-      think_time_->Start();
-      // my_move = ThinkMoveRandom();
-      my_move = ThinkMoveLoopAtack();
-      think_time_->Stop();
-      board_.SetMove(my_move);
-      printf("Set (X: %d, Y: %d, Tile: %c)\n",
-             my_move.x + board_.left, my_move.y + board_.top, my_move.tile);
-      // board_.PrintBorder();
-      // board_.PrintBoard();
-      // PrintProfile();
+      my_move = Think();
     }
   }
 };
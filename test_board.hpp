@@ -7,6 +7,8 @@
 
 #include "trax.h"
 #include "board.hpp"
+#include "move_list.hpp"
+#include "xoshiro.hpp"
 
 
 class TestBoard : public Board {
@@ -31,6 +33,29 @@ class TestBoard : public Board {
     printf(" --------------\n");
   }
 
+  /**
+   * Check whether every tile, cache and journal equals those of board
+   */
+  bool IsSameState(const TestBoard &board) {
+    return memcmp(blocks_, board.blocks_, sizeof(blocks_)) == 0 &&
+        num_frontier_ == board.num_frontier_ &&
+        memcmp(frontier_, board.frontier_,
+               sizeof(frontier_[0]) * num_frontier_) == 0 &&
+        memcmp(frontier_index_, board.frontier_index_,
+               sizeof(frontier_index_)) == 0 &&
+        memcmp(valid_shapes_, board.valid_shapes_,
+               sizeof(valid_shapes_)) == 0 &&
+        frontier_journal_.size() == board.frontier_journal_.size() &&
+        journal_size_ == board.journal_size_ &&
+        last_move_ == board.last_move_ &&
+        hash_ == board.hash_ &&
+        memcmp(paths_, board.paths_, sizeof(paths_)) == 0 &&
+        path_journal_.size() == board.path_journal_.size() &&
+        win_flags_ == board.win_flags_ &&
+        border_n_ == board.border_n_ && border_e_ == board.border_e_ &&
+        border_s_ == board.border_s_ && border_w_ == board.border_w_;
+  }
+
   /**
    * For TestSetMove
    */
@@ -166,6 +191,231 @@ class TestBoard : public Board {
     PrintIdealBoard();
   }
 
+  /**
+   * Test frontier and its legal-shape masks against a full board scan
+   */
+  void TestFrontier() {
+    TestSetMove();
+    int num_cells = 0;
+    for (int y = 1; y < BOARD_MAX - 1; y++) {
+      for (int x = 1; x < BOARD_MAX - 1; x++) {
+        int cell = y * BOARD_MAX + x;
+        bool in_frontier = (frontier_index_[cell] >= 0);
+        if (in_frontier != (IsEmpty(x, y) && !IsIsolated(x, y))) {
+          printf("Test Error: frontier of (%d, %d)\n", x, y);
+          exit(1);
+        }
+        if (!in_frontier) continue;
+        num_cells++;
+        for (int s = 0; s < SHAPE_NUM; s++) {
+          const char shape = (s == SHAPE_PLUS) ? '+' :
+              (s == SHAPE_SLASH) ? '/' : '\\';
+          if (((valid_shapes_[cell] >> s) & 0x1) != IsValidMove(x, y, shape)) {
+            printf("Test Error: valid shapes of (%d, %d)\n", x, y);
+            exit(1);
+          }
+        }
+      }
+    }
+    printf("Frontier: %d cells, expected %d\n", GetNumFrontier(), num_cells);
+  }
+
+  /**
+   * Test the rule and tile tables against a brute-force search over the
+   * six tiles for every tuple of around colors
+   */
+  void TestRuleTable() {
+    static const char tiles[] = {TILE_RED_NS, TILE_RED_EW, TILE_RED_WN,
+                                 TILE_RED_ES, TILE_RED_SW, TILE_RED_NE};
+    for (int index = 0; index < AROUND_NUM; index++) {
+      const RuleEntry &rule = GetRuleEntry(index);
+      int counts[3] = {0, 0, 0};
+      for (int d = DIR_N; d <= DIR_W; d++) counts[GetAroundColor(index, d)]++;
+      int valid_shapes = 0, num_forced = 0;
+      char fit_tiles[SHAPE_NUM] = {0, 0, 0}, forced_tile = TILE_SPACE;
+      for (int t = 0; t < 6; t++) {
+        int shape = GetShapeIndex(GetFieldShape(tiles[t]));
+        bool fits = true, forced = false;
+        for (int d = DIR_N; d <= DIR_W; d++) {
+          int color = GetAroundColor(index, d);
+          if (color != COL_CLEAR && color != GetEdgeColor(tiles[t], d)) {
+            fits = false;
+          }
+          // forced by two neighbors of a color meeting both of its edges
+          int e = GetPathExit(tiles[t], d);
+          if (color == GetEdgeColor(tiles[t], d) && e != d &&
+              GetAroundColor(index, e) == color) {
+            forced = true;
+          }
+        }
+        if (index == 0) fits = (GetEdgeColor(tiles[t], DIR_E) == COL_RED);
+        if (fits && counts[COL_WHITE] < 3 && counts[COL_RED] < 3) {
+          valid_shapes |= 1 << shape;
+        }
+        if (fits) fit_tiles[shape] = tiles[t];
+        if (forced) {
+          num_forced++;
+          forced_tile = tiles[t];
+        }
+      }
+      bool error = (rule.valid_shapes != valid_shapes);
+      for (int s = 0; s < SHAPE_NUM; s++) {
+        if (fit_tiles[s] && rule.tile[s] != fit_tiles[s]) error = true;
+      }
+      // more than one forced tile only with three neighbors of a color
+      if (num_forced > 1 && counts[COL_WHITE] < 3 && counts[COL_RED] < 3) {
+        error = true;
+      }
+      if (num_forced <= 1 &&
+          (rule.forced_tile != forced_tile ||
+           rule.forced_shape != GetFieldShape(forced_tile))) {
+        error = true;
+      }
+      if (error) {
+        printf("Test Error: rule table %d\n", index);
+        exit(1);
+      }
+    }
+    for (int t = 0; t <= TILE_MASK; t++) {
+      const TileEntry &tile = GetTileEntry(t);
+      int mirrored_h = SwapTileBits(t, DIR_E, DIR_W);
+      int mirrored_v = SwapTileBits(t, DIR_N, DIR_S);
+      bool is_tile = (t == TILE_SPACE);
+      for (int i = 0; i < 6; i++) is_tile = is_tile || (t == tiles[i]);
+      if (!is_tile) continue;
+      char shape = (t == TILE_SPACE) ? ' ' :
+          (((t >> DIR_N) & 0x1) == ((t >> DIR_S) & 0x1)) ? '+' :
+          (((t >> DIR_N) & 0x1) == ((t >> DIR_W) & 0x1)) ? '/' : '\\';
+      int color = (t == TILE_SPACE) ? COL_CLEAR : GetEdgeColor(t, DIR_E);
+      if (tile.shape != shape || tile.color != color ||
+          tile.flipped_h != mirrored_h || tile.flipped_v != mirrored_v) {
+        printf("Test Error: tile table %d\n", t);
+        exit(1);
+      }
+    }
+    printf("Rule table: OK\n");
+  }
+
+  /**
+   * Test move notation with two-letter columns parses and formats back
+   */
+  void TestNotation() {
+    static const char *strs[] = {"@0/", "Z1+", "AA26\\", "AZ3/", "BA10+"};
+    static const int xs[] = {0, 26, 27, 52, 53};
+    char buf[move::MAX_LENGTH];
+    for (int i = 0; i < 5; i++) {
+      move m(strs[i], strlen(strs[i]));
+      if (m.x != xs[i] || m.format(buf, sizeof(buf)) != (int)strlen(strs[i]) ||
+          strcmp(buf, strs[i]) != 0) {
+        printf("Test Error: notation %s -> %d -> %s\n", strs[i], m.x, buf);
+        exit(1);
+      }
+    }
+    for (int x = 0; x <= move::MAX_COORD; x++) {
+      move m, n;
+      m.x = x;
+      m.y = move::MAX_COORD - x;
+      m.tile = '\\';
+      int length = m.format(buf, sizeof(buf));
+      if (!n.parse(buf, length) || n.x != m.x || n.y != m.y) {
+        printf("Test Error: notation round trip %d %s\n", x, buf);
+        exit(1);
+      }
+    }
+    static const char *bad[] = {"", "@", "A+", "1/", "@A1+", "A1", "A1x",
+                                "a1+", "A1+ "};
+    for (int i = 0; i < 9; i++) {
+      move m;
+      if (m.parse(bad[i], strlen(bad[i]))) {
+        printf("Test Error: notation accepts \"%s\"\n", bad[i]);
+        exit(1);
+      }
+    }
+    const char line[] = "@0/ A2\\\tB1\\\r\n";
+    move moves[4];
+    if (move::parse_line(line, strlen(line), moves, 4) != 3 ||
+        moves[2].x != 2 || moves[2].y != 1 || moves[2].tile != '\\' ||
+        move::parse_line("Trax", 4, moves, 4) != -1 ||
+        move::parse_line(line, strlen(line), moves, 2) != -1) {
+      printf("Test Error: notation line\n");
+      exit(1);
+    }
+    printf("Notation: OK\n");
+  }
+
+  /**
+   * Test MakeMove and UnmakeMove restore the board exactly, the order of
+   * the frontier included, after random moves and their forced plays
+   */
+  void TestMakeUnmakeMove() {
+    static const int DEPTH = 8;
+    static const int ROUNDS = 100;
+    Xoshiro256 random(1);
+    InitializeBoard();
+    SetMove(50, 50, '+');
+    int num_forced = 0;
+    for (int round = 0; round < ROUNDS; round++) {
+      TestBoard *saved = new TestBoard(*this);
+      UndoToken tokens[DEPTH];
+      int depth = 0;
+      while (depth < DEPTH) {
+        MoveList moves;
+        GatherMoves(moves);
+        if (moves.GetSize() == 0) break;
+        tokens[depth] = MakeMove(moves[random.GetRange(moves.GetSize())]);
+        num_forced += GetNumForcedTiles();
+        if (!tokens[depth++].is_valid || GetWinFlags()) break;
+      }
+      for (int i = depth - 1; i >= 0; i--) {
+        UnmakeMove(tokens[i]);
+      }
+      if (!IsSameState(*saved)) {
+        printf("Test Error: round %d\n", round);
+        PrintBoard();
+        exit(1);
+      }
+      delete saved;
+
+      // one more tile for the next round, if it neither breaks the rules
+      // nor wins
+      MoveList moves;
+      GatherMoves(moves);
+      if (moves.GetSize() == 0) break;
+      UndoToken token = MakeMove(moves[random.GetRange(moves.GetSize())]);
+      if (!token.is_valid || GetWinFlags()) UnmakeMove(token);
+    }
+    if (num_forced == 0) {
+      printf("Test Error: no forced play\n");
+      exit(1);
+    }
+    printf("MakeMove/UnmakeMove: OK, %d forced tiles\n", num_forced);
+  }
+
+  /**
+   * Test GetHash is translation-invariant and GetCanonicalHash is also
+   * invariant under a mirror image
+   */
+  void TestHash() {
+    InitializeBoard();
+    SetMove(50, 50, '/');
+    SetMove(51, 50, '+');
+    SetMove(51, 51, '\\');
+    uint64_t hash = GetHash(), canonical = GetCanonicalHash();
+    InitializeBoard();
+    border_w_ = border_e_ = 60;
+    border_n_ = border_s_ = 40;
+    SetMove(60, 40, '/');
+    SetMove(61, 40, '+');
+    SetMove(61, 41, '\\');
+    printf("Translated: %s\n", (hash == GetHash()) ? "OK" : "NG");
+    InitializeBoard();
+    SetMove(51, 50, '\\');
+    SetMove(50, 50, '+');
+    SetMove(50, 51, '/');
+    printf("Mirrored: %s %s\n", (hash != GetHash()) ? "OK" : "NG",
+           (canonical == GetCanonicalHash()) ? "OK" : "NG");
+  }
+
   void EvaluateLoop(int x, int y) {
     printf("(%d, %d) ",  x, y);
     if (DetectWhiteLoop(x, y)) {
@@ -180,8 +430,7 @@ class TestBoard : public Board {
   }
 
   void InitializeBoard() {
-    memset(blocks_, 0, sizeof(char) * BOARD_MAX * BOARD_MAX);
-    border_n_ = border_e_ = border_s_ = border_w_ = BOARD_CENTER;
+    Clear();
   }
   
   /**
@@ -191,8 +440,8 @@ class TestBoard : public Board {
     // Test LOOP_WHITE_2_S
     printf("Test LOOP_WHITE_2_S: ");
     InitializeBoard();
-    SetMove(50, 50, '/');
     SetMove(51, 50, '\\');
+    SetMove(50, 50, '/');
     EvaluateLoop(50, 51);
     // Test LOOP_WHITE_2_N
     printf("Test LOOP_WHITE_2_N: ");
@@ -219,9 +468,9 @@ class TestBoard : public Board {
     // Test LOOP_WHITE_3_S
     printf("Test LOOP_WHITE_3_S: ");
     InitializeBoard();
-    SetMove(50, 50, '/');
-    SetMove(51, 50, '+');
     SetMove(52, 50, '\\');
+    SetMove(51, 50, '+');
+    SetMove(50, 50, '/');
     EvaluateLoop(50, 51);
     // Test LOOP_WHITE_3_N
     printf("Test LOOP_WHITE_3_N: ");
@@ -265,13 +514,14 @@ class TestBoard : public Board {
     // Test LOOP_RED_2_E
     printf("Test LOOP_RED_2_E: ");
     InitializeBoard();
-    SetMove(50, 50, '/');
     SetMove(51, 50, '/');
+    SetMove(50, 50, '/');
     SetMove(51, 51, '\\');
     EvaluateLoop(52, 50);
     // Test LOOP_RED_2_W
     printf("Test LOOP_RED_2_W: ");
     InitializeBoard();
+    SetMove(51, 50, '\\');
     SetMove(50, 50, '/');
     SetMove(50, 49, '\\');
     EvaluateLoop(49, 49);
@@ -295,14 +545,15 @@ class TestBoard : public Board {
     // Test LOOP_RED_3_E
     printf("Test LOOP_RED_3_E: ");
     InitializeBoard();
-    SetMove(50, 50, '/');
     SetMove(51, 50, '/');
+    SetMove(50, 50, '/');
     SetMove(51, 51, '+');
     SetMove(51, 52, '\\');
     EvaluateLoop(52, 50);
     // Test LOOP_RED_3_W
     printf("Test LOOP_RED_3_W: ");
     InitializeBoard();
+    SetMove(51, 50, '\\');
     SetMove(50, 50, '/');
     SetMove(50, 49, '+');
     SetMove(50, 48, '\\');
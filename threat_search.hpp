@@ -0,0 +1,194 @@
+#ifndef THREAT_SEARCH_HPP_
+#define THREAT_SEARCH_HPP_
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <atomic>
+
+#include "board.hpp"
+#include "move_list.hpp"
+#include "timer.hpp"
+
+
+/**
+ * Threat-space search for forced wins by loops and lines.
+ * A threat is a move after which its player could win with the next move.
+ * The attacker plays only threats, the defender every reply that stops
+ * all immediate wins, and forced plays are part of every move, so
+ * threats made through forced-play chains are found as well.
+ */
+class ThreatSearch {
+ private:
+
+  //----------------------------------------------------------------------------
+  // Typedefs and Constants
+  //----------------------------------------------------------------------------
+
+  enum Restriction {
+    CHECK_TIME_NODES = 1024,  // nodes between clock reads
+  };
+
+
+  //----------------------------------------------------------------------------
+  // Members
+  //----------------------------------------------------------------------------
+
+  uint64_t nodes_;   // moves made
+  double deadline_;  // ms of GetMonotonicTimeMs
+  bool stopped_;
+  const std::atomic<bool> *stop_;  // stops the search when set, or NULL
+  FILE *stats_;  // reports of forced wins, or NULL
+
+
+  //----------------------------------------------------------------------------
+  // Methods
+  //----------------------------------------------------------------------------
+
+  static inline int GetOpponent(const int player) {
+    return (player == 1) ? 2 : 1;
+  }
+
+  /**
+   * Make a move and count it, set stopped_ when the deadline passes or
+   * stop_ is set
+   */
+  inline Board::UndoToken MakeMove(Board &board, const MoveList::Move m) {
+    if (++nodes_ % CHECK_TIME_NODES == 0 &&
+        (GetMonotonicTimeMs() >= deadline_ ||
+         (stop_ && stop_->load(std::memory_order_relaxed)))) {
+      stopped_ = true;
+    }
+    return board.MakeMove(m);
+  }
+
+  /**
+   * OR node: attacker to move wins within depth moves
+   */
+  bool ProveWin(Board &board, const int attacker, const int depth,
+                MoveList::Move *best) {
+    if (FindImmediateWin(board, attacker, best)) return true;
+    if (depth <= 1 || stopped_) return false;
+    MoveList threats;
+    GatherThreats(board, attacker, threats);
+    for (int i = 0; i < threats.GetSize() && !stopped_; i++) {
+      Board::UndoToken token = MakeMove(board, threats[i]);
+      bool wins = IsDefenseless(board, attacker, depth);
+      board.UnmakeMove(token);
+      if (wins && !stopped_) {
+        if (best) *best = threats[i];
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /**
+   * AND node: every reply of the defender to a threat loses
+   */
+  bool IsDefenseless(Board &board, const int attacker, const int depth) {
+    const int defender = GetOpponent(attacker);
+    if (FindImmediateWin(board, defender, NULL)) return false;
+    MoveList replies;
+    board.GatherMoves(replies);
+    for (int i = 0; i < replies.GetSize() && !stopped_; i++) {
+      Board::UndoToken token = MakeMove(board, replies[i]);
+      bool is_defense = token.is_valid &&
+          board.GetWinner(defender) != attacker &&
+          !ProveWin(board, attacker, depth - 1, NULL);
+      board.UnmakeMove(token);
+      if (is_defense) return false;
+    }
+    return !stopped_;
+  }
+
+
+ public:
+
+  //----------------------------------------------------------------------------
+  // Methods
+  //----------------------------------------------------------------------------
+
+  /**
+   * Constractor
+   */
+  ThreatSearch() :
+      nodes_(0),
+      deadline_(0),
+      stopped_(false),
+      stop_(NULL),
+      stats_(NULL) {}
+
+  /**
+   * Report every forced win found to stats, NULL for none
+   */
+  void SetStatsFile(FILE *stats) {
+    stats_ = stats;
+  }
+
+  /**
+   * Find a move of player that wins at once, return false if none
+   */
+  bool FindImmediateWin(Board &board, const int player,
+                        MoveList::Move *win) {
+    MoveList moves;
+    board.GatherMoves(moves);
+    for (int i = 0; i < moves.GetSize(); i++) {
+      Board::UndoToken token = MakeMove(board, moves[i]);
+      bool wins = token.is_valid && board.GetWinner(player) == player;
+      board.UnmakeMove(token);
+      if (wins) {
+        if (win) *win = moves[i];
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /**
+   * Gather every loop or line threat of player, moves that neither break
+   * the rules nor end the game but leave player an immediate win
+   */
+  void GatherThreats(Board &board, const int player,
+                     MoveList &threats) {
+    MoveList moves;
+    board.GatherMoves(moves);
+    threats.Clear();
+    for (int i = 0; i < moves.GetSize() && !stopped_; i++) {
+      Board::UndoToken token = MakeMove(board, moves[i]);
+      if (token.is_valid && board.GetWinner(player) == 0 &&
+          FindImmediateWin(board, player, NULL)) {
+        threats.Push(moves[i]);
+      }
+      board.UnmakeMove(token);
+    }
+  }
+
+  /**
+   * Search a forced win of attacker to move within max_depth of its moves,
+   * deepening one move at a time until time_ms passes or stop is set.
+   * Return false if no forced win is found.
+   */
+  bool Search(Board &board, const int attacker, const int max_depth,
+              const double time_ms, MoveList::Move &best,
+              const std::atomic<bool> *stop = NULL) {
+    stop_ = stop;
+    nodes_ = 0;
+    stopped_ = false;
+    const double start = GetMonotonicTimeMs();
+    deadline_ = start + time_ms;
+    for (int depth = 1; depth <= max_depth && !stopped_; depth++) {
+      if (ProveWin(board, attacker, depth, &best)) {
+        if (stats_) {
+          fprintf(stats_, "Threat: win in %d, nodes %llu, %.1f ms\n", depth,
+                  (unsigned long long)nodes_, GetMonotonicTimeMs() - start);
+        }
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+
+#endif  // end THREAT_SEARCH_HPP_
@@ -2,92 +2,120 @@
 #define TIMER_HPP_
 
 
-// #include <sys/resource.h>
-#include <sys/time.h>
-#include <float.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
 
 
-class Timer {
+/**
+ * Monotonic wall clock in ms, for search deadlines
+ */
+inline double GetMonotonicTimeMs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+
+/**
+ * Profiling timer counting ticks of a monotonic cycle counter.
+ * Ticks are TSC cycles on x86, and nanoseconds elsewhere.
+ */
+class CycleTimer {
  private:
-  
-  // rusage start_;
-  // rusage stop_;
-  struct timeval start_;
-  struct timeval stop_;
-  float elapsed_time_;
-  float accum_time_;
-  float max_time_;
-  float min_time_;
+
+  uint64_t start_;
+  uint64_t elapsed_ticks_;
+  uint64_t accum_ticks_;
+  uint64_t max_ticks_;
+  uint64_t min_ticks_;
   int num_calls_;
-  std::string *name_;
+  const char *name_;
 
  public:
 
-  Timer() :
-      accum_time_(0),
-      max_time_(0),
-      min_time_(FLT_MAX),
-      num_calls_(0),
-      name_(NULL) {}
+  static inline uint64_t GetTicks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+  }
 
-  Timer(const char *name) :
-      accum_time_(0),
-      max_time_(0),
-      min_time_(FLT_MAX),
+  explicit CycleTimer(const char *name = NULL) :
+      start_(0),
+      elapsed_ticks_(0),
+      accum_ticks_(0),
+      max_ticks_(0),
+      min_ticks_(UINT64_MAX),
       num_calls_(0),
-      name_(new std::string(name)) {}
- 
-  void Start(void) {
-    // getrusage(RUSAGE_SELF, &start_);
-    gettimeofday(&start_, NULL);
-  }
+      name_(name) {}
 
-  inline void SetElapsedTime() {
-    // float sec = stop_.ru_utime.tv_sec - start_.ru_utime.tv_sec;
-    // float usec = stop_.ru_utime.tv_usec - start_.ru_utime.tv_usec;
-    float sec = stop_.tv_sec - start_.tv_sec;
-    float usec = stop_.tv_usec - start_.tv_usec;
-    elapsed_time_ = (sec * 1000) + (usec / 1000);
-    if (elapsed_time_ > max_time_) max_time_ = elapsed_time_;
-    if (elapsed_time_ < min_time_) min_time_ = elapsed_time_;
+  inline void Start(void) {
+    start_ = GetTicks();
   }
-  
-  void Stop(void) {
-    // getrusage(RUSAGE_SELF, &stop_);
-    gettimeofday(&stop_, NULL);
-    SetElapsedTime();
-    accum_time_ += elapsed_time_;
+
+  inline void Stop(void) {
+    elapsed_ticks_ = GetTicks() - start_;
+    if (elapsed_ticks_ > max_ticks_) max_ticks_ = elapsed_ticks_;
+    if (elapsed_ticks_ < min_ticks_) min_ticks_ = elapsed_ticks_;
+    accum_ticks_ += elapsed_ticks_;
     ++num_calls_;
   }
 
-  float GetElapsedTime(void) {
-    return elapsed_time_;
+  uint64_t GetElapsedTicks(void) {
+    return elapsed_ticks_;
   }
 
-  void GetAccumulatedTime(float &accum_time, int &count) {
-    accum_time = accum_time_;
+  void GetAccumulatedTicks(uint64_t &accum_ticks, int &count) {
+    accum_ticks = accum_ticks_;
     count = num_calls_;
   }
 
-  float GetMeanTime() {
-    return accum_time_ / num_calls_;
+  double GetMeanTicks() {
+    return num_calls_ ? (double)accum_ticks_ / num_calls_ : 0;
   }
 
   void PrintTime() {
-    // printf("Time (ms)\tCalls\tAvg (ms)\tMin (ms) \tMax (ms)\tName\n");
-    printf("%e\t", accum_time_);
+    // printf("Ticks\tCalls\tAvg (ticks)\tMin (ticks)\tMax (ticks)\tName\n");
+    printf("%llu\t", (unsigned long long)accum_ticks_);
     printf("%d\t", num_calls_);
-    printf("%e\t", GetMeanTime());
-    printf("%e\t", min_time_);
-    printf("%e\t", max_time_);
-    if (name_) {
-      const char *name = name_->c_str();
-      printf("%s", name);
-    }
+    printf("%e\t", GetMeanTicks());
+    printf("%llu\t", (unsigned long long)(num_calls_ ? min_ticks_ : 0));
+    printf("%llu\t", (unsigned long long)max_ticks_);
+    if (name_) printf("%s", name_);
     printf("\n");
   }
 };
 
 
+/**
+ * Profiling timer of release builds, every call compiles to nothing
+ */
+class NullTimer {
+ public:
+
+  explicit NullTimer(const char *name = NULL) {}
+  inline void Start(void) {}
+  inline void Stop(void) {}
+  inline void PrintTime() {}
+};
+
+
+/**
+ * Profiling policy, define TRAX_PROFILE to measure Board and TraxSolver
+ */
+#ifdef TRAX_PROFILE
+typedef CycleTimer ProfileTimer;
+#else
+typedef NullTimer ProfileTimer;
+#endif  // end TRAX_PROFILE
+
+
 
 #endif  // end TIMER_HPP_
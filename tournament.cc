@@ -0,0 +1,379 @@
+/*
+   Self-play tournament between two engine variants
+
+   Usage:
+     trax -t [-n games] [-j threads] [-o file | -r plies] [-m moves]
+             [-s seed] engine engine
+
+     engine is mode[:time_ms], mode is one of random, loop, search,
+     iterative or mcts and time_ms the time to think a move (1000 by
+     default). Games are played on a pool of threads, each game with its
+     own referee and TraxSolvers, and an MCTS engine uses one thread.
+     An engine can also be a command with a '/' or a space, such as
+     "./trax-engine -e mcts -j 2":500, run by /bin/sh as a child process
+     that speaks the protocol of engine.cc. Each thread starts its own
+     child per such engine and keeps it for its games. A child that
+     dies, or answers neither in time nor after stop, loses by forfeit.
+     Games go in pairs on the same opening, the first engine playing
+     white (player 1, who makes the first move of the opening) in the
+     first game of a pair and red in the second. An opening is "@0+"
+     unless -o gives a file of openings, one per line, used in turn, or
+     -r plays that many random legal moves for each pair. A game
+     reaching -m moves (400 by default) or the edge of the board is a
+     draw.
+
+     One line per game is printed as it ends:
+       game  white  winner  result  moves
+     and then the wins, losses and draws of the first engine, the Elo
+     difference with its 95% error bar and the mean think time per move
+     of each engine. The seed (-s) fixes the openings and the random
+     choices of the engines in each game, whatever the threads.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "trax.h"
+#include "engine_process.hpp"
+#include "solver.hpp"
+#include "timer.hpp"
+#include "xoshiro.hpp"
+
+struct tournament_engine {
+  std::string name;
+  int mode;              // of TraxSolver, -1 for a command
+  std::string command;   // run as a child process
+  double time_ms;
+};
+
+struct tournament_game {
+  int first_white;       // 1 if the first engine plays white
+  int winner;            // engine 0 or 1, -1 for a draw or an error
+  const char* result;    // loop, line, violation, forfeit, draw or error
+  int num_moves;
+  double think_ms[2];    // of each engine
+  int think_moves[2];
+};
+
+struct tournament {
+  tournament_engine engines[2];
+  std::vector<std::vector<move> > openings;
+  int random_plies;
+  int max_moves;
+  uint64_t seed;
+  std::mutex out_mutex;  // of the lines of finished games
+};
+
+static const int MAX_OPENING_TRIES = 100;
+
+
+static bool parse_engine(const char* spec, tournament_engine& e){
+  std::string s = spec;
+  std::string base = s;
+  size_t colon = s.rfind(':');
+  e.name = s;
+  e.time_ms = 1000;
+  if(colon != std::string::npos && colon+1 < s.length() &&
+     s.find_first_not_of("0123456789.", colon+1) == std::string::npos){
+    base = s.substr(0, colon);
+    e.time_ms = atof(s.c_str()+colon+1);
+  }
+  e.mode = TraxSolver::GetEngineMode(base);
+  e.command.clear();
+  if(e.mode < 0 && base.find_first_of("/ ") != std::string::npos)
+    e.command = base;
+  return (e.mode >= 0 || !e.command.empty()) && e.time_ms > 0;
+}
+
+static bool read_openings(const char* filename,
+                          std::vector<std::vector<move> >& openings){
+  std::ifstream ifs(filename);
+  if(!ifs) return false;
+  std::vector<move> moves(1024);
+  std::string line;
+  while(std::getline(ifs, line)){
+    int num = move::parse_line(line.data(), line.length(), &moves[0],
+                               moves.size());
+    if(num > 0)
+      openings.push_back(std::vector<move>(moves.begin(),
+                                           moves.begin()+num));
+  }
+  return !openings.empty();
+}
+
+// plies random legal moves that neither win nor break the rules
+static std::vector<move> random_opening(const int plies, Xoshiro256& rng){
+  std::vector<move> opening;
+  for(int tries=0; tries<MAX_OPENING_TRIES; tries++){
+    Board* board = new Board();
+    opening.clear();
+    opening.push_back(move(rng.GetRange(2) ? "@0+" : "@0/"));
+    board->SetMove(opening[0]);
+    for(int i=1; i<plies; i++){
+      MoveList moves;
+      board->GatherMoves(moves);
+      if(moves.GetSize()==0) break;
+      MoveList::Move m = moves[rng.GetRange(moves.GetSize())];
+      opening.push_back(board->ToMove(m));
+      if(!board->SetMove(opening.back()) || board->GetWinFlags()) break;
+    }
+    bool ok = (int)opening.size()==plies && !board->GetWinFlags();
+    delete board;
+    if(ok) break;
+  }
+  return opening;
+}
+
+// Start a new game on the child process of engine e, starting the
+// child first if it is not running
+static bool start_process(const tournament_engine& e, EngineProcess& proc){
+  if(proc.NewGame()) return true;
+  return proc.Start(e.command) && proc.NewGame();
+}
+
+// End game r with result, unless it has already ended. A game is a draw
+// until it ends otherwise.
+static void set_result(tournament_game& r, const int winner,
+                       const char* result){
+  if(strcmp(r.result, "draw")!=0) return;
+  r.winner = winner;
+  r.result = result;
+}
+
+// Play game g of the tournament, procs the child processes of commands
+static void play_game(tournament& tm, const int g,
+                      const std::vector<move>& opening,
+                      EngineProcess procs[2], tournament_game& r){
+  trax ref;
+  TraxSolver* solvers[2] = {0, 0};  // of player 1 and 2, 0 for a command
+  int engine_of[2];
+  std::vector<move> moves;  // of the game, for a command
+
+  r.first_white = (g%2==0);
+  r.winner = -1;
+  r.result = "draw";
+  r.num_moves = 0;
+  for(int e=0; e<2; e++){
+    r.think_ms[e] = 0;
+    r.think_moves[e] = 0;
+  }
+
+  ref.clear_board();
+  for(int p=1; p<=2; p++){
+    int e = (p==1) == r.first_white ? 0 : 1;
+    engine_of[p-1] = e;
+    if(!tm.engines[e].command.empty()){
+      if(!start_process(tm.engines[e], procs[e])){
+        procs[e].Close();
+        set_result(r, 1-e, "forfeit");
+      }
+      continue;
+    }
+    solvers[p-1] = new TraxSolver(p, tm.engines[e].mode,
+                                  tm.seed + 2*(uint64_t)g);
+    solvers[p-1]->SetThinkTime(tm.engines[e].time_ms);
+    solvers[p-1]->SetNumThreads(1);
+  }
+
+  int p = 1;
+  for(size_t i=0; strcmp(r.result, "draw")==0 && i<opening.size(); i++){
+    if(!ref.place(opening[i]) || !ref.is_board_consistent() ||
+       ref.winner(p)){
+      set_result(r, -1, "error");
+      break;
+    }
+    ref.clear_marks();
+    for(int s=0; s<2; s++)
+      if(solvers[s]) solvers[s]->SetMove(opening[i]);
+    moves.push_back(opening[i]);
+    r.num_moves++;
+    p = (p==2) ? 1 : 2;
+  }
+
+  while(strcmp(r.result, "draw")==0 && r.num_moves < tm.max_moves){
+    int e = engine_of[p-1];
+    double start = GetMonotonicTimeMs();
+    move mo;
+    if(solvers[p-1]){
+      mo = solvers[p-1]->Think();
+    } else if(!procs[e].Go(moves, tm.engines[e].time_ms, mo)){
+      // a late answer would be taken for the next move, so the child
+      // is killed and started again for the next game
+      procs[e].Close();
+      set_result(r, 1-e, "forfeit");
+      break;
+    }
+    r.think_ms[e] += GetMonotonicTimeMs() - start;
+    r.think_moves[e]++;
+
+    // a move this far out would run off the referee's board arrays, the
+    // game ends as a draw without it
+    if(!ref.fits(mo)) break;
+    if(!ref.place(mo) || !ref.is_board_consistent()){
+      set_result(r, 1-e, "violation");
+      break;
+    }
+    r.num_moves++;
+    int winner = ref.winner(p);
+    if(winner){
+      set_result(r, engine_of[winner-1], ref.loop() ? "loop" : "line");
+      break;
+    }
+    ref.clear_marks();
+    if(solvers[(p==2) ? 0 : 1]) solvers[(p==2) ? 0 : 1]->SetMove(mo);
+    moves.push_back(mo);
+    p = (p==2) ? 1 : 2;
+  }
+
+  delete solvers[0];
+  delete solvers[1];
+}
+
+static void tournament_worker(tournament& tm,
+                              std::vector<tournament_game>& games,
+                              std::atomic<int>& next){
+  EngineProcess procs[2];  // of the engines that are commands
+  for(int g=next++; g<(int)games.size(); g=next++){
+    std::vector<move> opening(1, move("@0+"));
+    if(tm.random_plies > 0){
+      Xoshiro256 rng(tm.seed ^ (0x9e3779b97f4a7c15ULL * (g/2 + 1)));
+      opening = random_opening(tm.random_plies, rng);
+    } else if(!tm.openings.empty()){
+      opening = tm.openings[(g/2) % tm.openings.size()];
+    }
+
+    tournament_game& r = games[g];
+    play_game(tm, g, opening, procs, r);
+
+    std::lock_guard<std::mutex> lock(tm.out_mutex);
+    printf("%d\t%s\t%s\t%s\t%d\n", g,
+           tm.engines[r.first_white ? 0 : 1].name.c_str(),
+           r.winner < 0 ? "-" : tm.engines[r.winner].name.c_str(),
+           r.result, r.num_moves);
+    fflush(stdout);
+  }
+}
+
+// Elo difference of score s, the share of points won
+static double elo(const double s){
+  return 400.0 * log10(s / (1.0 - s));
+}
+
+static void print_elo(FILE* out, const int wins, const int losses,
+                      const int draws){
+  int n = wins + losses + draws;
+  if(n==0) return;
+  double s = (wins + 0.5*draws) / n;
+  fprintf(out, "Score %.3f, ", s);
+  if(s <= 0.0 || s >= 1.0){
+    fprintf(out, "Elo difference %s\n", s <= 0.0 ? "-inf" : "+inf");
+    return;
+  }
+  // standard error of the mean score of a game, 1.96 of it for 95%
+  double var = (wins*(1.0-s)*(1.0-s) + draws*(0.5-s)*(0.5-s) +
+                losses*s*s) / n;
+  double margin = 1.96 * sqrt(var / n);
+  double lo = s - margin, hi = s + margin;
+  fprintf(out, "Elo difference %+.1f", elo(s));
+  if(lo <= 0.0 || hi >= 1.0)
+    fprintf(out, " (95%% interval unbounded)\n");
+  else
+    fprintf(out, " +/- %.1f (95%%)\n", (elo(hi) - elo(lo)) / 2);
+}
+
+int tournament_main(int argc, char* argv[]){
+  tournament tm;
+  int num_games = 100;
+  int num_threads = std::thread::hardware_concurrency();
+  int num_engines = 0;
+  const char* openings = 0;
+
+  tm.random_plies = 0;
+  tm.max_moves = 400;
+  tm.seed = time(0);
+  for(int i=0; i<argc; i++){
+    if(strcmp(argv[i], "-n")==0 && i+1<argc){
+      num_games = atoi(argv[++i]);
+    } else if(strcmp(argv[i], "-j")==0 && i+1<argc){
+      num_threads = atoi(argv[++i]);
+    } else if(strcmp(argv[i], "-o")==0 && i+1<argc){
+      openings = argv[++i];
+    } else if(strcmp(argv[i], "-r")==0 && i+1<argc){
+      tm.random_plies = atoi(argv[++i]);
+    } else if(strcmp(argv[i], "-m")==0 && i+1<argc){
+      tm.max_moves = atoi(argv[++i]);
+    } else if(strcmp(argv[i], "-s")==0 && i+1<argc){
+      tm.seed = strtoull(argv[++i], 0, 10);
+    } else if(num_engines < 2 && parse_engine(argv[i],
+                                              tm.engines[num_engines])){
+      num_engines++;
+    } else {
+      num_engines = -1;
+      break;
+    }
+  }
+  if(num_engines != 2 || num_games < 1){
+    fprintf(stderr, "usage: trax -t [-n games] [-j threads] "
+            "[-o file | -r plies] [-m moves] [-s seed] engine engine\n"
+            "  engine: mode[:time_ms] or command[:time_ms], mode: random, "
+            "loop, search, iterative or mcts\n");
+    return 1;
+  }
+  if(openings && !read_openings(openings, tm.openings)){
+    fprintf(stderr, "trax: no openings in %s\n", openings);
+    return 1;
+  }
+  if(num_threads < 1) num_threads = 1;
+
+  double start = GetMonotonicTimeMs();
+  std::vector<tournament_game> games(num_games);
+  std::atomic<int> next(0);
+  std::vector<std::thread> threads;
+  for(int i=0; i<num_threads; i++)
+    threads.push_back(std::thread(tournament_worker, std::ref(tm),
+                                  std::ref(games), std::ref(next)));
+  for(size_t i=0; i<threads.size(); i++) threads[i].join();
+  double elapsed = GetMonotonicTimeMs() - start;
+
+  int wins = 0, losses = 0, draws = 0, errors = 0;
+  double think_ms[2] = {0, 0};
+  int think_moves[2] = {0, 0};
+  for(size_t g=0; g<games.size(); g++){
+    const tournament_game& r = games[g];
+    if(strcmp(r.result, "error")==0){
+      errors++;
+      continue;
+    }
+    if(r.winner==0) wins++;
+    else if(r.winner==1) losses++;
+    else draws++;
+    for(int e=0; e<2; e++){
+      think_ms[e] += r.think_ms[e];
+      think_moves[e] += r.think_moves[e];
+    }
+  }
+
+  FILE* out = stdout;
+  fprintf(out, "%s vs %s: %d games, W %d L %d D %d, %d errors\n",
+          tm.engines[0].name.c_str(), tm.engines[1].name.c_str(),
+          num_games, wins, losses, draws, errors);
+  print_elo(out, wins, losses, draws);
+  for(int e=0; e<2; e++)
+    fprintf(out, "%s: %.1f ms per move, %d moves\n",
+            tm.engines[e].name.c_str(),
+            think_moves[e] ? think_ms[e] / think_moves[e] : 0.0,
+            think_moves[e]);
+  fprintf(out, "seed %llu, %d threads, %.1f s\n",
+          (unsigned long long)tm.seed, num_threads, elapsed / 1000);
+  fflush(out);
+  return errors ? 1 : 0;
+}
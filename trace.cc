@@ -1,4 +1,5 @@
 #include <iostream>
+#include <algorithm>
 #include "trax.h"
 
 bool trax::trace_loop(const int x, const int y, const int d, const int mark=0){
@@ -6,7 +7,7 @@ bool trax::trace_loop(const int x, const int y, const int d, const int mark=0){
   int xx=x; int yy=y; int dir=d;
 
   do {
-    int next_dir;
+    int next_dir = dir;
 
     switch(dir){
     case 1: // up
@@ -61,9 +62,11 @@ bool trax::trace_loop(const int x, const int y){
 	break;
       }
 
-      if(col==1) red_loop = true;
-      else white_loop = true;
-      
+      bool& loop_flag = (col==1) ? red_loop : white_loop;
+      if(!loop_flag)
+	notify(trax_event::LOOP, x, y, board[x][y], col==1 ? 1 : 2, 0);
+      loop_flag = true;
+
       found = true;
     }
 
@@ -84,7 +87,7 @@ bool trax::trace_line(const int x, const int y, const int d, const int mark=0){
 
   if (mark!=0) board_marks[xx][yy]=mark;
   do {
-    int next_dir;
+    int next_dir = dir;
 
     switch(dir){
     case 1: // up
@@ -121,38 +124,82 @@ bool trax::trace_line(const int x, const int y, const int d, const int mark=0){
 }
 
 
+// Follow a path from the tile at (x, y) leaving it in direction dir
+// until it steps into an empty cell, and leave that cell and the
+// direction of the last step in x, y and dir.
+// Return false if the path is a loop. It may cross the other path of a
+// '+' at (x, y), so the loop is closed only when it leaves as it began.
+bool trax::trace_end(int& x, int& y, int& dir){
+  const int sx=x; const int sy=y; const int sdir=dir;
+
+  while(true){
+    switch(dir){
+    case 1: y--; break; // up
+    case 2: y++; break; // down
+    case 3: x--; break; // left
+    case 4: x++; break; // right
+    }
+    if (board[x][y]==' ') return true;
+
+    switch(dir){
+    case 1: dir = board[x][y]=='/' ? 4 : board[x][y]=='\\' ? 3 : 1; break;
+    case 2: dir = board[x][y]=='/' ? 3 : board[x][y]=='\\' ? 4 : 2; break;
+    case 3: dir = board[x][y]=='/' ? 2 : board[x][y]=='\\' ? 1 : 3; break;
+    case 4: dir = board[x][y]=='/' ? 1 : board[x][y]=='\\' ? 2 : 4; break;
+    }
+    if (x==sx && y==sy && dir==sdir) return false;
+  }
+}
+
+// The line entering the tile at (x, y) from the left (d=4) or from the
+// top (d=2) is found: mark it and set the flag of its color.
+void trax::found_line(const int x, const int y, const int d){
+  trace_line(x, y, d, 2);  // mark the trace
+
+  // color of the left or the top edge of the tile
+  int col = board_color[x][y];
+  if (d==4 && board[x][y]!='+') col = opposite_color(col);
+  if (d==2 && board[x][y]!='\\') col = opposite_color(col);
+
+  bool& line_flag = (col==1) ? red_line : white_line;
+  if(!line_flag)
+    notify(trax_event::LINE, x, y, board[x][y], col==1 ? 1 : 2, 0);
+  line_flag = true;
+}
+
+// A new line has to run through a tile placed by the last move, since
+// the ends of an older path cannot move onto a new edge of the board.
+// So only the two paths of each of those tiles are traced to their ends.
 bool trax::trace_line(){
+  // exit directions of the two paths of '+', '/' and '\'
+  static const int exits[3][2][2] = {
+    { {3, 4}, {1, 2} }, { {1, 3}, {2, 4} }, { {1, 4}, {2, 3} } };
+
   bool found = false;
 
-  for(int y=top; y<=bottom; y++){
-    if(board[left+1][y]!=' '){ // horizontal candidate!
-      if(trace_line(left+1, y, 4)){
-	trace_line(left+1, y, 4, 2);  // mark the trace
-	if (board_color[left+1][y] == 1) red_line = true;
-	else white_line = true;
+  for(size_t i=0; i<touched.size(); i++){
+    int x = touched[i] / BOARD_MAX;
+    int y = touched[i] % BOARD_MAX;
+    int t = board[x][y]=='+' ? 0 : board[x][y]=='/' ? 1 : 2;
+
+    for(int p=0; p<2; p++){
+      int x1=x; int y1=y; int d1=exits[t][p][0];
+      int x2=x; int y2=y; int d2=exits[t][p][1];
+      if (!trace_end(x1, y1, d1) || !trace_end(x2, y2, d2)) continue;
+
+      if (d1==4 || d1==2){ // end 1 is the left or the top one
+	std::swap(x1, x2); std::swap(y1, y2); std::swap(d1, d2);
+      }
+      if (d1==3 && d2==4 && x1==left && x2==right+1 && (right-left)>=8){
+	found_line(left+1, y1, 4);
 	found = true;
       }
-    }
-  }
-
-  for(int x=left; x<=right; x++){
-    if(board[x][top+1]!=' '){ // vertical candidate!
-      if(trace_line(x, top+1, 2)){
-	trace_line(x, top+1, 2, 2);   // mark the trace
-	int col;
-	col = board_color[x][top+1];
-	if(board[x][top+1]=='+' || board[x][top+1]=='\\')
-	  col = opposite_color(col);
-
-	if(col==1) red_line = true;
-	else white_line = true;
-	found = true;   
+      if (d1==1 && d2==2 && y1==top && y2==bottom+1 && (bottom-top)>=8){
+	found_line(x1, top+1, 2);
+	found = true;
       }
     }
   }
 
-  // if (found)
-  //   std::cout << "[DEBUG] ---- " << ( red_line ? "RED" : "WHITE" ) << " LINE! ----\n";
-
   return found;
 }
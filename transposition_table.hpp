@@ -0,0 +1,221 @@
+#ifndef TRANSPOSITION_TABLE_HPP_
+#define TRANSPOSITION_TABLE_HPP_
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/**
+ * Fixed-size transposition table keyed by position hash.
+ * Entries are grouped into cache-line sized buckets, and a probe touches
+ * only one bucket.
+ */
+class TranspositionTable {
+ public:
+
+  //----------------------------------------------------------------------------
+  // Typedefs and Constants
+  //----------------------------------------------------------------------------
+
+  enum Bound {
+    BOUND_NONE  = 0,
+    BOUND_UPPER = 1,  // failed low, true score <= score
+    BOUND_LOWER = 2,  // failed high, true score >= score
+    BOUND_EXACT = 3,
+  };
+
+  enum ReplacementPolicy {
+    REPLACE_ALWAYS          = 0,  // overwrite a slot picked by key
+    REPLACE_DEPTH_PREFERRED = 1,  // overwrite stale or shallowest slot
+  };
+
+  enum Restriction {
+    CACHE_LINE_SIZE = 64,
+    MOVE_NONE = 0xffff,
+  };
+
+  /**
+   * 16 byte entry
+   */
+  struct Entry {
+    uint64_t key;
+    int16_t score;
+    uint16_t move;
+    uint8_t depth;
+    uint8_t bound;
+    uint8_t generation;
+    uint8_t reserved;
+  };
+
+  enum BucketLayout {
+    BUCKET_ENTRIES = CACHE_LINE_SIZE / sizeof(Entry),
+  };
+
+  struct Bucket {
+    Entry entries[BUCKET_ENTRIES];
+  };
+
+
+ private:
+
+  //----------------------------------------------------------------------------
+  // Members
+  //----------------------------------------------------------------------------
+
+  Bucket *buckets_;
+  uint64_t num_buckets_;  // power of 2
+  int policy_;
+  uint8_t generation_;
+
+  // Statistics
+  uint64_t num_probes_;
+  uint64_t num_hits_;
+  uint64_t num_stores_;
+
+
+  //----------------------------------------------------------------------------
+  // Methods
+  //----------------------------------------------------------------------------
+
+  inline Bucket &GetBucket(const uint64_t key) {
+    return buckets_[key & (num_buckets_ - 1)];
+  }
+
+  /**
+   * Select a slot to overwrite with key
+   */
+  inline Entry &SelectVictim(Bucket &bucket, const uint64_t key) {
+    for (int i = 0; i < BUCKET_ENTRIES; i++) {
+      if (bucket.entries[i].key == key) return bucket.entries[i];
+    }
+    if (policy_ == REPLACE_ALWAYS) {
+      return bucket.entries[(key >> 32) % BUCKET_ENTRIES];
+    }
+    Entry *victim = &bucket.entries[0];
+    for (int i = 0; i < BUCKET_ENTRIES; i++) {
+      Entry &entry = bucket.entries[i];
+      if (entry.bound == BOUND_NONE) return entry;
+      bool stale = (entry.generation != generation_);
+      bool victim_stale = (victim->generation != generation_);
+      if (stale != victim_stale) {
+        if (stale) victim = &entry;
+      } else if (entry.depth < victim->depth) {
+        victim = &entry;
+      }
+    }
+    return *victim;
+  }
+
+
+ public:
+
+  //----------------------------------------------------------------------------
+  // Methods
+  //----------------------------------------------------------------------------
+
+  /**
+   * Constractor
+   * size_mb: memory budget in MB, rounded down to a power of 2 buckets
+   */
+  explicit TranspositionTable(const int size_mb,
+                              const int policy = REPLACE_DEPTH_PREFERRED) :
+      buckets_(NULL),
+      num_buckets_(1),
+      policy_(policy),
+      generation_(0),
+      num_probes_(0),
+      num_hits_(0),
+      num_stores_(0) {
+    uint64_t budget = (uint64_t)size_mb * 1024 * 1024;
+    while (num_buckets_ * 2 * sizeof(Bucket) <= budget) {
+      num_buckets_ *= 2;
+    }
+    void *ptr = NULL;
+    if (posix_memalign(&ptr, CACHE_LINE_SIZE,
+                       num_buckets_ * sizeof(Bucket)) != 0) {
+      perror("TranspositionTable ");
+      exit(-1);
+    }
+    buckets_ = static_cast<Bucket *>(ptr);
+    Clear();
+  }
+
+  /**
+   * Destructor
+   */
+  ~TranspositionTable() {
+    free(buckets_);
+  }
+
+  /**
+   * Remove all entries
+   */
+  void Clear() {
+    memset(buckets_, 0, num_buckets_ * sizeof(Bucket));
+    generation_ = 0;
+  }
+
+  /**
+   * Start a new search, entries of older searches become replaceable
+   */
+  void NewSearch() {
+    generation_++;
+  }
+
+  /**
+   * Find entry of key, return false if not found
+   */
+  inline bool Probe(const uint64_t key, Entry &found) {
+    Bucket &bucket = GetBucket(key);
+    num_probes_++;
+    for (int i = 0; i < BUCKET_ENTRIES; i++) {
+      Entry &entry = bucket.entries[i];
+      if (entry.key == key && entry.bound != BOUND_NONE) {
+        entry.generation = generation_;
+        found = entry;
+        num_hits_++;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /**
+   * Store a search result of key
+   */
+  inline void Store(const uint64_t key, const int depth, const int bound,
+                    const int score, const int move) {
+    Entry &entry = SelectVictim(GetBucket(key), key);
+    // keep the best move of a shallower search of the same position
+    if (entry.key != key || move != MOVE_NONE) {
+      entry.move = move;
+    }
+    entry.key = key;
+    entry.score = score;
+    entry.depth = depth;
+    entry.bound = bound;
+    entry.generation = generation_;
+    num_stores_++;
+  }
+
+  /**
+   * Get size of table in bytes
+   */
+  inline uint64_t GetSize() {
+    return num_buckets_ * sizeof(Bucket);
+  }
+
+  void PrintStatistics() {
+    printf("TT: %llu KB, probes %llu, hits %llu, stores %llu\n",
+           (unsigned long long)(GetSize() / 1024),
+           (unsigned long long)num_probes_,
+           (unsigned long long)num_hits_,
+           (unsigned long long)num_stores_);
+  }
+};
+
+
+#endif  // end TRANSPOSITION_TABLE_HPP_
@@ -51,6 +51,8 @@ void trax::clear_board(){
 
   red_loop = white_loop = false;
   red_line = white_line = false;
+
+  touched.clear();
 }
 
 
@@ -76,74 +78,125 @@ std::ostream& operator<<(std::ostream& stream, const trax& t){
 }
 
 
+void trax::notify(const int type, const int x, const int y, const char tile,
+		  const int color, const char* reason){
+  if (!listener) return;
+
+  trax_event e;
+  e.type = type;
+  e.x = x-left;
+  e.y = y-top;
+  e.tile = tile;
+  e.color = color;
+  e.reason = reason;
+  listener(e, listener_data);
+}
+
+void trax::print_event(const trax_event& e, void* data){
+  std::ostream& stream = *(std::ostream*)data;
+
+  switch(e.type){
+  case trax_event::FORCED:
+    break;  // main prints the whole chain from forced_plays
+  case trax_event::VIOLATION:
+  case trax_event::NOTICE:
+    stream << "**** " << e.reason << " ****\n";
+    break;
+  case trax_event::LOOP:
+  case trax_event::LINE:
+    stream << "---- " << (e.color==1 ? "RED" : "WHITE")
+	   << (e.type==trax_event::LOOP ? " LOOP" : " LINE") << "! ----\n";
+    break;
+  }
+}
+
+
 int trax::opposite_color(const int c){
   if (c==0) return 0;
   if (c==1) return 2;
   return 1;
 }
 
-void trax::get_around_colors(const int x, const int y,
-		       int& lc, int& rc, int& uc, int& dc){
-  // left color
-  lc = board_color[x-1][y]; 
-
-  // right color
-  rc = board[x+1][y]=='+' ? board_color[x+1][y] :
-    opposite_color(board_color[x+1][y]);
+// Tile of (x, y) as a TilePattern of Rules. board_color is the color of
+// the right hand side, a tile without one is taken as empty.
+int trax::GetTileField(const int x, const int y) const {
+  if (board[x][y]==' ' || board_color[x][y]==0) return TILE_SPACE;
+  return GetShapeTile(GetShapeIndex(board[x][y]),
+		      board_color[x][y]==1 ? COL_RED : COL_WHITE);
+}
 
-  // up color
-  uc = board[x][y-1]=='+' ? opposite_color(board_color[x][y-1]) :
-    board[x][y-1]=='/' ? board_color[x][y-1] :
-    opposite_color(board_color[x][y-1]);
 
-  // down color
-   dc = board[x][y+1]=='+' ? opposite_color(board_color[x][y+1]) :
-    board[x][y+1]=='\\' ? board_color[x][y+1] :
-    opposite_color(board_color[x][y+1]);
+// The cell of mo is one cell inside the board arrays, so that reading its
+// neighbors stays inside too. Tiles forced by it fill cells between
+// placed tiles, so they stay inside as well.
+bool trax::fits(const move& mo) const {
+  int x = left + mo.x;
+  int y = top  + mo.y;
+  return mo.x >= 0 && mo.y >= 0 &&
+    x >= 1 && x <= BOARD_MAX-2 && y >= 1 && y <= BOARD_MAX-2;
 }
 
-
 bool trax::place(move mo){
   int x = left +mo.x;
   int y = top  +mo.y;
   if (mo.x == 0){ left--; }
   if (mo.y == 0){ top--;   }
+  touched.clear();
 
   if (board[x][y] != ' '){
-    std::cout << "**** ALREADY OCCUPIED! ****\n";
+    notify(trax_event::VIOLATION, x, y, mo.tile, 0, "ALREADY OCCUPIED!");
     return false;
   }
 
   board_marks[x][y] = 1;
-  
+
   if (right < x) right = x;
   bottom = (bottom < y) ? y : bottom;
   return place(x, y, mo.tile);
 }
 
+// Place a tile and every tile it forces, breadth first from the tiles
+// placed so far. A forced tile breaking the rules ends the chain, which
+// is_board_consistent then reports.
 bool trax::place(const int x, const int y, const char tile){
-  int color = 0;
+  static const int dx[4] = {-1, 1,  0, 0};
+  static const int dy[4] = { 0, 0, -1, 1};
+
+  size_t first = touched.size();
+  if(!put(x, y, tile)) return false;
+
+  bool ok = true;
+  for(size_t i=first; ok && i<touched.size(); i++){
+    for(int d=0; ok && d<4; d++){
+      int fx = touched[i]/BOARD_MAX + dx[d];
+      int fy = touched[i]%BOARD_MAX + dy[d];
+      char forced = forced_tile(fx, fy);
+      if(forced == ' ') continue;
+
+      notify(trax_event::FORCED, fx, fy, forced, 0, 0);
+      ok = put(fx, fy, forced);
+    }
+  }
 
-  board[x][y] = tile;
+  for(size_t i=first; i<touched.size(); i++){
+    int tx = touched[i]/BOARD_MAX;
+    int ty = touched[i]%BOARD_MAX;
+    if(board_color[tx][ty] != 0) trace_loop(tx, ty);
+  }
+  trace_line();
 
-  // check left, right, up, down
-  int lc, rc, uc, dc;
-  get_around_colors(x, y, lc, rc, uc, dc);
+  return true;
+}
 
-  // Isolated
-  if ( lc==rc && rc==uc && uc==dc && dc == 0 ){
-    std::cout << "**** ISOLATED ****\n";
-    color = 1; // This should happen only at 1st move only. 
-  }
+// Place one tile and color it, without forced play
+bool trax::put(const int x, const int y, const char tile){
+  board[x][y] = tile;
+  touched.push_back(x*BOARD_MAX+y);
 
+  int index = GetAroundIndex(x, y);
+  if (index == 0)
+    notify(trax_event::NOTICE, x, y, tile, 0, "ISOLATED"); // 1st move only
 
-  // Tiles around
-  std::cout << (lc!=0 ? ((lc==1 ? esc_red : "") + "L" + esc_normal) : "")
-	    << (rc!=0 ? ((rc==1 ? esc_red : "") + "R" + esc_normal) : "")
-	    << (uc!=0 ? ((uc==1 ? esc_red : "") + "U" + esc_normal) : "")
-	    << (dc!=0 ? ((dc==1 ? esc_red : "") + "D" + esc_normal) : "")
-	    << "\n";
-  
   // 3 same color check
   if(is_prohibited_3(x, y)) return false; // if true, it's prohibited pattern
   
@@ -151,46 +204,40 @@ bool trax::place(const int x, const int y, const char tile){
   if(!is_consistent_placement(x, y, tile)) return false;
 
   // color the tile
-  if (color==0){ // if not already colored
-    if (tile=='+')  color = (lc==1 || rc==1 || uc==2 || dc==2) ? 1 : 2;
-    if (tile=='/')  color = (lc==1 || uc==1 || dc==2 || rc==2) ? 2 : 1;
-    if (tile=='\\') color = (lc==1 || dc==1 || uc==2 || rc==2) ? 2 : 1;
-  }
+  int color = GetTileEntry(GetRuleEntry(index).tile[GetShapeIndex(tile)]).color;
+  board_color[x][y] = (color==COL_RED) ? 1 : 2;
 
-  if (color==0) std::cout << "**** SOMETHING IS WRONG ****\n";
-  board_color[x][y]=color;
-
-  scan_forced();
-  trace_loop(x, y);
-  trace_line();
-  
   return true;
 }
 
-bool trax::scan_forced(){
-  for(int y=top; y<=bottom; y++){
-    for(int x=left; x<=right; x++){
-      if(board_color[x][y] != 0) continue;
-
-      int lc, rc, uc, dc;
-      get_around_colors(x, y, lc, rc, uc, dc);
-
-      char forced = ' ';
-      if ( (lc==uc && uc!=0 ) || (dc==rc && rc!=0 ) ) forced = '/'; 
-      if ( (rc==uc && uc!=0 ) || (dc==lc && lc!=0 ) ) forced = '\\';
-      if ( (lc==rc && rc!=0 && rc!=dc && rc!=uc) ||
-	   (uc==dc && dc!=0 && dc!=lc && dc!=lc) ) forced = '+';
-
-      if(forced != ' '){
-	std::cout << "Forced play: [X:" << x-left << ", Y:" << y-top
-		  << ", Tile:" << forced << "] ";
-	place(x, y, forced);
-	return true; 
-      }
-    }
+// The tile forced on the empty cell (x, y), or ' ' if none
+char trax::forced_tile(const int x, const int y){
+  if(x<left || right<x || y<top || bottom<y) return ' ';
+  if(board[x][y] != ' ') return ' ';
+  return GetForcedShape(x, y);
+}
+
+// The tiles forced by the last move in the order they were placed, in the
+// notation of the board after the move
+std::vector<move> trax::forced_plays() const {
+  std::vector<move> plays;
+  for(size_t i=1; i<touched.size(); i++){
+    move mo;
+    mo.x = touched[i]/BOARD_MAX - left;
+    mo.y = touched[i]%BOARD_MAX - top;
+    mo.tile = board[left+mo.x][top+mo.y];
+    plays.push_back(mo);
   }
-  // No more forced play here
-  return false;
+  return plays;
+}
+
+// The winner after player p's move, or 0 if nobody has a loop or a line.
+// Player 1 plays white and 2 red, and a move winning for both wins for p.
+int trax::winner(const int p) const {
+  if(!loop() && !line()) return 0;
+  if(p==1 && red() && !white()) return 2;
+  if(p==2 && white() && !red()) return 1;
+  return p;
 }
 
 // ----------------------------------------------------------------------
@@ -208,10 +255,24 @@ std::string player(int p){
 #include "solver.hpp"
 #include "recorder.hpp"
 
-int main(){
+int main(int argc, char* argv[]){
+  // trax -b: adjudicate recorded games, see batch.cc
+  if(argc > 1 && std::string(argv[1])=="-b")
+    return batch_main(argc-2, argv+2);
+  // trax -f: check the referee against the solver boards, see fuzz.cc
+  if(argc > 1 && std::string(argv[1])=="-f")
+    return fuzz_main(argc-2, argv+2);
+  // trax -t: self-play tournament, see tournament.cc
+  if(argc > 1 && std::string(argv[1])=="-t")
+    return tournament_main(argc-2, argv+2);
+  // trax -T: self-test of Board, see selftest.cc
+  if(argc > 1 && std::string(argv[1])=="-T")
+    return selftest_main(argc-2, argv+2);
+
   trax t;
   
   t.clear_board();
+  t.set_listener(trax::print_event, &std::cout);
 
   // first move is either "@0/" or "@0+"
   std::string m;
@@ -223,6 +284,8 @@ int main(){
   Recorder rec(0);
   TraxSolver p1_solver(1);
   TraxSolver p2_solver(2);
+  p1_solver.SetStatsFile(stdout);
+  p2_solver.SetStatsFile(stdout);
   move mo(""), opp_mo("");
   
   //  std::cout << t;
@@ -254,19 +317,21 @@ int main(){
       // place a move
       if(!t.place(mo)) violation = true;
 
+      std::vector<move> forced = t.forced_plays();
+      if (!forced.empty()){
+	char buf[move::MAX_LENGTH];
+	std::cout << "Forced plays:";
+	for (size_t i=0; i<forced.size(); i++){
+	  forced[i].format(buf, sizeof(buf));
+	  std::cout << " " << buf;
+	}
+	std::cout << " ";
+      }
+
       std::cout << t;
       if (t.is_board_consistent()){
 	if(t.loop() || t.line()){
-	  int winner = p;
-
-	  switch(winner){
-	  case 1:
-	    if (t.red() && !t.white()) winner=2;
-	    break;
-	  case 2:
-	    if (t.white() && !t.red()) winner=1;
-	    break;
-	  }
+	  int winner = t.winner(p);
 	  std::cout << "---- Player " << winner << "(" << player(winner)
 		    << ") GOT A " << (t.loop() ? "LOOP" : "LINE")
 		    << " in player " << p << "(" << player(p)
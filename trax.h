@@ -1,25 +1,66 @@
 #include <ostream>
+#include <vector>
+
+#include "rules.hpp"
 
 #ifndef _TRAX_H_
 #define _TRAX_H_
 
 class move {
 public:
+  static const int MAX_COORD = 9999;
+  static const int MAX_LENGTH = 16;  // longest notation and its NUL
+
   int x, y;
   char tile;
+  move();
   move(const std::string);
+  move(const char*, const int);
+
+  bool parse(const char*, const int);
+  int format(char*, const int) const;
+  static int parse_line(const char*, const int, move*, const int);
+};
+
+// What the referee reports while placing tiles. x and y are relative
+// to the bounding box as in the notation.
+struct trax_event {
+  enum { FORCED, VIOLATION, LOOP, LINE, NOTICE };
+
+  int type;
+  int x, y;
+  char tile;
+  int color;           // LOOP, LINE: 1 red, 2 white
+  const char* reason;  // VIOLATION, NOTICE
 };
 
-class trax {
+typedef void (*trax_listener)(const trax_event&, void*);
+
+// The placement rules come from Rules, which reads the board through
+// GetTileField.
+class trax : public Rules<trax> {
 public:
   static const int BOARD_MAX = 100;
 
+  // No console I/O unless a listener is set
+  trax() : listener(0), listener_data(0) {}
+
+  void set_listener(trax_listener l, void* data){
+    listener = l;
+    listener_data = data;
+  }
+  // listener writing the events to the std::ostream* data
+  static void print_event(const trax_event&, void*);
+
   void clear_marks();
   void clear_board();
 
-  bool is_board_consistent();
+  bool is_board_consistent();       // cells placed by the last move
+  bool is_board_consistent_full();  // every cell, for debugging
+  bool fits(const move&) const;  // place stays inside the board arrays
   bool place(move);
   bool place(const int, const int, const char);
+  std::vector<move> forced_plays() const;  // tiles forced by the last move
 
   bool trace_loop();
   bool trace_line();
@@ -28,20 +69,29 @@ public:
   bool line() const  { return (red_line || white_line); }
   bool red() const   { return (red_line || red_loop); };
   bool white() const { return (white_line || white_loop); };
+  int winner(const int) const;  // after player's move, 0 if none
+
+  int GetTileField(const int x, const int y) const;
 
 protected:
-  bool scan_forced();
+  bool put(const int, const int, const char);
+  char forced_tile(const int, const int);
 
-  void get_around_colors(const int, const int, int&, int&, int&, int&);
   bool trace_loop(const int, const int, const int, const int);
   bool trace_loop(const int, const int);
   bool trace_line(const int, const int, const int, const int);
+  bool trace_end(int&, int&, int&);
+  void found_line(const int, const int, const int);
 
   bool is_prohibited_3(const int x, const int y);
   bool is_consistent_placement(int x, int y, char tile);
   bool is_line_color_connected(int x, int y);
+  bool is_cell_consistent(const int x, const int y);
 
   int opposite_color(const int);
+
+  void notify(const int, const int, const int, const char,
+              const int, const char*);
   
   char board[BOARD_MAX][BOARD_MAX];
   char board_color[BOARD_MAX][BOARD_MAX];
@@ -49,6 +99,11 @@ protected:
 
   int left, right, top, bottom;
   bool white_loop, red_loop, white_line, red_line;
+
+  std::vector<int> touched;  // x*BOARD_MAX+y placed since the last move
+
+  trax_listener listener;
+  void* listener_data;
   
   friend std::ostream& operator<<(std::ostream&, const trax&);
 };
@@ -57,5 +112,10 @@ protected:
 std::ostream& operator<<(std::ostream&, const move&);
 std::ostream& operator<<(std::ostream&, const trax&);
 
+int batch_main(int, char*[]);
+int fuzz_main(int, char*[]);
+int tournament_main(int, char*[]);
+int selftest_main(int, char*[]);
+
 #endif
 
@@ -0,0 +1,66 @@
+#ifndef TRX_RECORD_HPP_
+#define TRX_RECORD_HPP_
+
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "trax.h"
+
+
+/**
+ * Reader of .trx game records.
+ * A record is header lines followed by move lines, as the .trx files in
+ * tests, or one move per line as written by Recorder.
+ */
+class TrxRecord {
+ private:
+
+  //----------------------------------------------------------------------------
+  // Typedefs and Constants
+  //----------------------------------------------------------------------------
+
+  enum Restriction {
+    MAX_LINE_MOVES = 1024,
+  };
+
+
+ public:
+
+  //----------------------------------------------------------------------------
+  // Methods
+  //----------------------------------------------------------------------------
+
+  /**
+   * Append the moves of the record in filename to moves, and its lines
+   * that are not moves to metadata
+   * Return false if the file cannot be read or a line after the first
+   * move line is not moves
+   */
+  static bool Read(const char *filename, std::vector<move> &moves,
+                   std::string &metadata) {
+    std::ifstream ifs(filename);
+    if (!ifs) return false;
+    std::vector<move> line_moves(MAX_LINE_MOVES);
+    std::string line;
+    bool has_moves = false;
+    while (std::getline(ifs, line)) {
+      int num = move::parse_line(line.data(), line.length(), &line_moves[0],
+                                 MAX_LINE_MOVES);
+      if (num < 0) {
+        if (has_moves) return false;
+        if (!metadata.empty()) metadata += '\n';
+        metadata += line;
+        continue;
+      }
+      moves.insert(moves.end(), line_moves.begin(),
+                   line_moves.begin() + num);
+      if (num > 0) has_moves = true;
+    }
+    return true;
+  }
+};
+
+
+#endif  // end TRX_RECORD_HPP_
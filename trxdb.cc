@@ -0,0 +1,166 @@
+/*
+   trxdb: binary game record database
+
+   Usage:
+     trxdb build db record...   convert .trx records into db
+     trxdb list db              print one line per game
+     trxdb show db game [move]  print the moves of a game, or one move
+
+     A record is header lines followed by move lines, as the .trx files
+     in tests, or one move per line as written by Recorder. Header lines
+     are kept as the metadata of the game, and the result is found by
+     replaying the moves on Board. A move off the board is a violation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "trax.h"
+#include "board.hpp"
+#include "game_database.hpp"
+#include "timer.hpp"
+#include "trx_record.hpp"
+
+
+static const char *RESULT_NAMES[] = {"none", "loop", "line", "violation"};
+
+/**
+ * Replay moves on board, white first, until a win or a violation
+ */
+static void Adjudicate(const std::vector<move> &moves, int &winner,
+                       int &result_type, int &result_move) {
+  Board *board = new Board();
+  winner = 0;
+  result_type = GameDatabase::RESULT_NONE;
+  result_move = moves.size();
+  for (size_t i = 0; i < moves.size(); i++) {
+    const move &m = moves[i];
+    const int player = (i % 2 == 0) ? 1 : 2;
+    const int x = m.x + board->left, y = m.y + board->top;
+    bool is_valid = (i == 0) ? (m.x == 0 && m.y == 0) :
+        (board->IsInside(m) && board->IsEmpty(x, y) &&
+         !board->IsIsolated(x, y) && board->IsValidMove(m));
+    if (!is_valid || !board->SetMove(m)) {
+      winner = (player == 1) ? 2 : 1;
+      result_type = GameDatabase::RESULT_VIOLATION;
+      result_move = i;
+      break;
+    }
+    if (board->GetWinFlags()) {
+      winner = board->GetWinner(player);
+      result_type = (board->GetWinFlags() &
+                     (Board::WIN_WHITE_LOOP | Board::WIN_RED_LOOP)) ?
+          GameDatabase::RESULT_LOOP : GameDatabase::RESULT_LINE;
+      result_move = i;
+      break;
+    }
+  }
+  delete board;
+}
+
+static int Build(const char *db_name, const int num_files, char **files) {
+  GameDatabaseWriter writer;
+  if (!writer.Open(db_name)) {
+    fprintf(stderr, "trxdb: cannot create %s\n", db_name);
+    return 1;
+  }
+  const double start = GetMonotonicTimeMs();
+  long long num_moves = 0;
+  int num_games = 0;
+  for (int i = 0; i < num_files; i++) {
+    std::vector<move> moves;
+    std::string metadata;
+    if (!TrxRecord::Read(files[i], moves, metadata)) {
+      fprintf(stderr, "trxdb: cannot read %s, skipped\n", files[i]);
+      continue;
+    }
+    if (!GameDatabaseWriter::CanPack(moves)) {
+      fprintf(stderr, "trxdb: %s has a move beyond column or row %d, "
+              "skipped\n", files[i], GameDatabase::MAX_COORD);
+      continue;
+    }
+    int winner, result_type, result_move;
+    Adjudicate(moves, winner, result_type, result_move);
+    if (!writer.AddGame(moves, metadata, winner, result_type, result_move)) {
+      fprintf(stderr, "trxdb: cannot write %s\n", db_name);
+      return 1;
+    }
+    num_moves += moves.size();
+    num_games++;
+  }
+  if (!writer.Close()) {
+    fprintf(stderr, "trxdb: cannot write %s\n", db_name);
+    return 1;
+  }
+  printf("%s: %d games, %lld moves, %.1f ms\n", db_name, num_games,
+         num_moves, GetMonotonicTimeMs() - start);
+  return 0;
+}
+
+static int List(const GameDatabase &db) {
+  for (int i = 0; i < db.GetNumGames(); i++) {
+    const GameDatabase::GameEntry &game = db.GetGame(i);
+    int length;
+    const char *metadata = db.GetMetadata(i, length);
+    const char *newline = (const char *)memchr(metadata, '\n', length);
+    if (newline) length = newline - metadata;
+    char result[32];
+    if (game.result_type == GameDatabase::RESULT_NONE) {
+      snprintf(result, sizeof(result), "%s", RESULT_NAMES[0]);
+    } else {
+      snprintf(result, sizeof(result), "%s at %u",
+               RESULT_NAMES[game.result_type & 0x3], game.result_move + 1);
+    }
+    printf("%d\t%u moves\twinner %d\t%s\t%.*s\n", i, game.num_moves,
+           game.winner, result, length, metadata);
+  }
+  return 0;
+}
+
+static int Show(const GameDatabase &db, const int game, const int i) {
+  if (game < 0 || game >= db.GetNumGames()) {
+    fprintf(stderr, "trxdb: no game %d\n", game);
+    return 1;
+  }
+  const int num_moves = db.GetGame(game).num_moves;
+  if (i >= num_moves) {
+    fprintf(stderr, "trxdb: game %d has %d moves\n", game, num_moves);
+    return 1;
+  }
+  char buf[move::MAX_LENGTH];
+  for (int j = (i < 0) ? 0 : i; j < ((i < 0) ? num_moves : i + 1); j++) {
+    db.GetMove(game, j).format(buf, sizeof(buf));
+    printf("%s%c", buf, (j + 1 < num_moves && i < 0) ? ' ' : '\n');
+  }
+  return 0;
+}
+
+static void Usage() {
+  fprintf(stderr, "usage: trxdb build db record...\n"
+          "       trxdb list db\n"
+          "       trxdb show db game [move]\n");
+  exit(1);
+}
+
+
+int main(int argc, char *argv[]) {
+  if (argc < 3) Usage();
+  const char *command = argv[1], *db_name = argv[2];
+  if (strcmp(command, "build") == 0) {
+    return Build(db_name, argc - 3, argv + 3);
+  }
+  GameDatabase db;
+  if (!db.Open(db_name)) {
+    fprintf(stderr, "trxdb: cannot open %s\n", db_name);
+    return 1;
+  }
+  if (strcmp(command, "list") == 0 && argc == 3) return List(db);
+  if (strcmp(command, "show") == 0 && (argc == 4 || argc == 5)) {
+    return Show(db, atoi(argv[3]), (argc == 5) ? atoi(argv[4]) : -1);
+  }
+  Usage();
+  return 1;
+}
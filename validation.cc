@@ -2,15 +2,9 @@
 #include "trax.h"
 
 bool trax::is_prohibited_3(const int x, const int y){
-  int lc, rc, uc, dc;
-
-  get_around_colors(x, y, lc, rc, uc, dc);
-  if ( ( lc==rc && rc==uc && uc!=0 ) ||
-       ( rc==uc && uc==dc && dc!=0 ) ||
-       ( uc==dc && dc==lc && lc!=0 ) ||
-       ( dc==lc && lc==rc && rc!=0 ) ) {
-
-    std::cout << "**** 3 LINES WITH SAME COLOR! ****\n";
+  if (IsProhibited3(x, y)){
+    notify(trax_event::VIOLATION, x, y, board[x][y], 0,
+           "3 LINES WITH SAME COLOR!");
     return true;
   }
   return false;
@@ -18,96 +12,82 @@ bool trax::is_prohibited_3(const int x, const int y){
 
 // pre-place check (not sufficient for post-place check)
 bool trax::is_consistent_placement(int x, int y, char tile){
-  int lc, rc, uc, dc;
-
-  
-  get_around_colors(x, y, lc, rc, uc, dc);
-  if (tile=='+'){
-    if (lc!=rc && (lc!=0 && rc!=0)){
-      std::cout << "**** DIFFERENT COLOR ON LEFT & RIGHT ON '+' ****\n";
-      return false;
-    }
-
-    if (uc!=dc && (uc!=0 && dc!=0)){
-      std::cout << "**** DIFFERENT COLOR ON UPPER & LOWER ON '+' ****\n";
-      return false;
-    }
-  }
-
-  if (tile=='/'){
-    if (lc!=uc && (lc!=0 && uc!=0)){
-      std::cout << "**** DIFFERENT COLOR ON LEFT & UPPER ON '/' ****\n";
-      return false;
-    }
-
-    if (dc!=rc && (dc!=0 && rc!=0)){
-      std::cout << "**** DIFFERENT COLOR ON LOWER & RIGHT ON '/' ****\n";
-      return false;
-    }
-  }
-
-  if (tile=='\\'){
-    if (lc!=dc && (lc!=0 && dc!=0)){
-      std::cout << "**** DIFFERENT COLOR ON LEFT & LOWER ON '\\' ****\n";
-      return false;
-    }
-
-    if (uc!=rc && (uc!=0 && rc!=0)){
-      std::cout << "**** DIFFERENT COLOR ON UPPER & RIGHT ON '\\' ****\n";
+  // sides that a tile connects, and what is said when their colors differ
+  static const struct { char tile; int d0, d1; const char* reason; } pairs[] = {
+    {'+',  DIR_W, DIR_E, "DIFFERENT COLOR ON LEFT & RIGHT ON '+'"},
+    {'+',  DIR_N, DIR_S, "DIFFERENT COLOR ON UPPER & LOWER ON '+'"},
+    {'/',  DIR_W, DIR_N, "DIFFERENT COLOR ON LEFT & UPPER ON '/'"},
+    {'/',  DIR_S, DIR_E, "DIFFERENT COLOR ON LOWER & RIGHT ON '/'"},
+    {'\\', DIR_W, DIR_S, "DIFFERENT COLOR ON LEFT & LOWER ON '\\'"},
+    {'\\', DIR_N, DIR_E, "DIFFERENT COLOR ON UPPER & RIGHT ON '\\'"},
+  };
+  int index = GetAroundIndex(x, y);
+
+  for (int i=0; i<6; i++){
+    if (pairs[i].tile==tile &&
+        IsPairConflict(index, pairs[i].d0, pairs[i].d1)){
+      notify(trax_event::VIOLATION, x, y, tile, 0, pairs[i].reason);
       return false;
     }
   }
-
   return true;
 }
 
 // post-place test
 bool trax::is_line_color_connected(int x, int y){
   // compare with my color
-  int lc, rc, uc, dc;
-  char tile = board[x][y];
-  
-  get_around_colors(x, y, lc, rc, uc, dc);
-  
-  int my_l, my_r, my_u, my_d;
-  my_r = board_color[x][y];
-  my_l = (tile=='+')  ? my_r : opposite_color(my_r);
-  my_u = (tile=='\\') ? my_r : opposite_color(my_r);
-  my_d = (tile=='/')  ? my_r : opposite_color(my_r);
-
-  if(my_r!=rc && (rc!=0)){
-    std::cout << "**** DIFFERENT COLOR ON RIGHT EDGE ****\n";
-    return false;
-  }
-
-  if(my_l!=lc && (lc!=0)){
-    std::cout << "**** DIFFERENT COLOR ON LEFT EDGE ****\n";
-    return false;
+  static const struct { int d; const char* reason; } edges[] = {
+    {DIR_E, "DIFFERENT COLOR ON RIGHT EDGE"},
+    {DIR_W, "DIFFERENT COLOR ON LEFT EDGE"},
+    {DIR_N, "DIFFERENT COLOR ON TOP EDGE"},
+    {DIR_S, "DIFFERENT COLOR ON BOTTOM EDGE"},
+  };
+  int index = GetAroundIndex(x, y);
+  int field = GetTileField(x, y);
+
+  for (int i=0; i<4; i++){
+    // a tile left without a color meets no colored edge
+    bool fit = (field==TILE_SPACE) ?
+      GetAroundColor(index, edges[i].d)==COL_CLEAR :
+      IsFitEdge(index, field, edges[i].d);
+    if (!fit){
+      notify(trax_event::VIOLATION, x, y, board[x][y], 0, edges[i].reason);
+      return false;
+    }
   }
+  return true;
+}
 
-  if(my_u!=uc && (uc!=0)){
-    std::cout << "**** DIFFERENT COLOR ON TOP EDGE ****\n";
-    return false;
+bool trax::is_cell_consistent(const int x, const int y){
+  if (board[x][y]!=' '){
+    if (!is_consistent_placement(x, y, board[x][y])) return false;
+    if (!is_line_color_connected(x, y)) return false;
   }
 
-  if(my_d!=dc && (dc!=0)){
-    std::cout << "**** DIFFERENT COLOR ON BOTTOM EDGE ****\n";
-    return false;
-  }
+  if (board[x][y]==' ')
+    if (is_prohibited_3(x,y)) return false;
   return true;
 }
 
+// A cell is checked against its 4 neighbors only, so the cells placed
+// by the last move and their neighbors are the only ones that can have
+// become inconsistent.
 bool trax::is_board_consistent(){
-  for (int y=1; y<BOARD_MAX; y++){
-    for (int x=1; x<BOARD_MAX; x++){
-      if (board[x][y]!=' '){
-	if (!is_consistent_placement(x, y, board[x][y])) return false;
-	if (!is_line_color_connected(x, y)) return false;
-      }
-
-      if (board[x][y]==' ')
-	if (is_prohibited_3(x,y)) return false;
-    }
+  for (size_t i=0; i<touched.size(); i++){
+    int x = touched[i] / BOARD_MAX;
+    int y = touched[i] % BOARD_MAX;
+    if (!is_cell_consistent(x, y)) return false;
+    if (!is_cell_consistent(x-1, y)) return false;
+    if (!is_cell_consistent(x+1, y)) return false;
+    if (!is_cell_consistent(x, y-1)) return false;
+    if (!is_cell_consistent(x, y+1)) return false;
   }
   return true;
 }
+
+bool trax::is_board_consistent_full(){
+  for (int y=1; y<BOARD_MAX-1; y++)
+    for (int x=1; x<BOARD_MAX-1; x++)
+      if (!is_cell_consistent(x, y)) return false;
+  return true;
+}
@@ -0,0 +1,102 @@
+#ifndef XOSHIRO_HPP_
+#define XOSHIRO_HPP_
+
+
+#include <stdint.h>
+
+
+/**
+ * xoshiro256** pseudo random number generator.
+ * The same seed gives the same sequence, and Jump() splits a sequence
+ * into 2^128 long streams for threads.
+ */
+class Xoshiro256 {
+ private:
+
+  //----------------------------------------------------------------------------
+  // Members
+  //----------------------------------------------------------------------------
+
+  uint64_t s_[4];
+
+
+  //----------------------------------------------------------------------------
+  // Methods
+  //----------------------------------------------------------------------------
+
+  static inline uint64_t Rotl(const uint64_t x, const int k) {
+    return (x << k) | (x >> (64 - k));
+  }
+
+  /**
+   * splitmix64, to fill the state from one seed
+   */
+  static inline uint64_t SplitMix64(uint64_t &x) {
+    uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+  }
+
+
+ public:
+
+  //----------------------------------------------------------------------------
+  // Methods
+  //----------------------------------------------------------------------------
+
+  /**
+   * Constractor
+   */
+  explicit Xoshiro256(const uint64_t seed = 0) {
+    Seed(seed);
+  }
+
+  void Seed(uint64_t seed) {
+    for (int i = 0; i < 4; i++) {
+      s_[i] = SplitMix64(seed);
+    }
+  }
+
+  inline uint64_t Next() {
+    const uint64_t result = Rotl(s_[1] * 5, 7) * 9;
+    const uint64_t t = s_[1] << 17;
+    s_[2] ^= s_[0];
+    s_[3] ^= s_[1];
+    s_[1] ^= s_[2];
+    s_[0] ^= s_[3];
+    s_[2] ^= t;
+    s_[3] = Rotl(s_[3], 45);
+    return result;
+  }
+
+  /**
+   * Get a number in [0, n) without division
+   */
+  inline int GetRange(const int n) {
+    return (int)(((Next() >> 32) * (uint64_t)n) >> 32);
+  }
+
+  /**
+   * Advance 2^128 steps, same as 2^128 calls of Next()
+   */
+  void Jump() {
+    static const uint64_t JUMP[4] = {
+      0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+      0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL,
+    };
+    uint64_t s[4] = {0, 0, 0, 0};
+    for (int i = 0; i < 4; i++) {
+      for (int b = 0; b < 64; b++) {
+        if (JUMP[i] & (1ULL << b)) {
+          for (int j = 0; j < 4; j++) s[j] ^= s_[j];
+        }
+        Next();
+      }
+    }
+    for (int j = 0; j < 4; j++) s_[j] = s[j];
+  }
+};
+
+
+#endif  // end XOSHIRO_HPP_